@@ -15,6 +15,9 @@
  */
 package io.zatarox.satellite;
 
+import java.nio.channels.ServerSocketChannel;
+import java.util.Map;
+
 /**
  * Defines a set of methods that a BackgroundProcess instance can use to communicate with
  * the container.
@@ -36,4 +39,13 @@ public interface BackgroundContext {
      */
     public String[] getArguments();
 
+    /**
+     * Returns the listening sockets opened by the launcher on behalf of the
+     * process (deimos <code>-listen</code>), by name. They stay open across
+     * the restarts and reloads of the process: connections wait in their
+     * accept queue meanwhile, so they must be accepted from but never
+     * closed. The map is empty when no socket was handed over.
+     */
+    public Map<String, ServerSocketChannel> getListeners();
+
 }
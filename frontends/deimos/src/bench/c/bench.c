@@ -0,0 +1,417 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Microbenchmarks of the native routines run by deimos on every start:
+ * replace(), the classpath evaluation of arguments() (memstrcat), the
+ * jvm.cfg parsing of home() and the JAVA_HOME tree walk of location.c.
+ *
+ * Usage: deimosBench [-time <ms>] [benchmark name prefix...]
+ */
+
+#define _GNU_SOURCE
+#include "deimos.h"
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <ftw.h>
+
+/* Allocation counting: malloc and friends are interposed for the whole
+ * process (including the C library) and forwarded to the glibc allocator.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void  __libc_free(void *ptr);
+
+static bool counting = false;
+static unsigned long allocs = 0;
+static unsigned long long allocated = 0;
+
+void *malloc(size_t size)
+{
+    if (counting) {
+        allocs++;
+        allocated += size;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    if (counting) {
+        allocs++;
+        allocated += nmemb * size;
+    }
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (counting) {
+        allocs++;
+        allocated += size;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);
+    void (*run)(void);
+} bench;
+
+/* Inputs shared by the benchmarks */
+static char *input = NULL;
+static char *output = NULL;
+static int   outlen = 0;
+static char *classpath = NULL;
+static char  tree[PATH_MAX];
+
+static unsigned long long now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Build a string of count repetitions of a pattern */
+static char *repeat(const char *pattern, int count)
+{
+    size_t len = strlen(pattern);
+    char *result = (char *)malloc(len * count + 1);
+    int x;
+
+    for (x = 0; x < count; x++)
+        memcpy(result + x * len, pattern, len);
+    result[len * count] = '\0';
+    return result;
+}
+
+static void replace_setup(int count, const char *pattern, const char *rpl)
+{
+    free(input);
+    free(output);
+    input  = repeat(pattern, count);
+    outlen = (strlen(input) / strlen("$JAVA_HOME") + 1) * strlen(rpl)
+             + strlen(input) + 1;
+    output = (char *)malloc(outlen);
+}
+
+static void replace_grow_setup(void)
+{
+    replace_setup(256, "$JAVA_HOME/lib/ext/x.jar:", "/usr/lib/jvm/java-8-openjdk-amd64");
+}
+
+static void replace_grow_run(void)
+{
+    replace(output, outlen, input, "$JAVA_HOME", "/usr/lib/jvm/java-8-openjdk-amd64");
+}
+
+static void replace_shrink_run(void)
+{
+    replace(output, outlen, input, "$JAVA_HOME", "/j");
+}
+
+/* Build a classpath of count entries, every tenth one being a wildcard */
+static void classpath_setup(int count)
+{
+    char entry[PATH_MAX + 16];
+    size_t len = 0;
+    int x;
+
+    free(classpath);
+    classpath = (char *)malloc(count * sizeof(entry));
+    classpath[0] = '\0';
+    for (x = 0; x < count; x++) {
+        if (x % 10 == 9)
+            snprintf(entry, sizeof(entry), "%s%s/lib/*", x ? ":" : "", tree);
+        else
+            snprintf(entry, sizeof(entry), "%s/opt/application/lib/dependency-%d.jar",
+                     x ? ":" : "", x);
+        strcpy(classpath + len, entry);
+        len += strlen(entry);
+    }
+}
+
+static void classpath_100_setup(void)
+{
+    classpath_setup(100);
+}
+
+static void classpath_2000_setup(void)
+{
+    classpath_setup(2000);
+}
+
+/* arguments() has no release function, and leaves string literals in the
+ * fields a command line does not set: free what the benchmarked command
+ * lines allocate */
+static void release_args(arg_data *args)
+{
+    int x;
+
+    if (args == NULL)
+        return;
+    for (x = 0; x < args->onum; x++)
+        free(args->opts[x]);
+    for (x = 0; x < args->anum; x++)
+        free(args->args[x]);
+    free(args->opts);
+    free(args->args);
+    free(args->threadcpus);
+    free(args->listen);
+    free(args->jar);
+    free(args);
+    /* Set by every parse */
+    free(log_prog);
+    log_prog = "deimos";
+}
+
+static void classpath_run(void)
+{
+    char *argv[] = { "deimos", "-cp", classpath, "main.jar", NULL };
+
+    release_args(arguments(4, argv));
+}
+
+static void options_run(void)
+{
+    char *argv[] = {
+        "deimos", "-server", "-Xms1g", "-Xmx1g", "-XX:+UseG1GC",
+        "-XX:MaxGCPauseMillis=100", "-Dapplication.name=benchmark",
+        "-Dapplication.home=/opt/application", "-Duser.timezone=UTC",
+        "-Dfile.encoding=UTF-8", "-verbose:gc", "-ea", "-esa",
+        "-agentpath:/opt/agent/libagent.so=port=9000",
+        "-javaagent:/opt/agent/agent.jar=config=/opt/agent/agent.conf",
+        "-pidfile", "/var/run/benchmark.pid", "-outfile", "SYSLOG",
+        "-errfile", "SYSLOG", "main.jar", "first", "second", NULL
+    };
+    arg_data *args = arguments(sizeof(argv) / sizeof(char *) - 1, argv);
+
+    if (args != NULL) {
+        free(args->name);
+        free(args->pidf);
+        free(args->outfile);
+        free(args->errfile);
+    }
+    release_args(args);
+}
+
+static void mkfile(const char *dir, const char *name, const char *content)
+{
+    char path[PATH_MAX];
+    FILE *file;
+
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path))
+        return;
+    file = fopen(path, "w");
+    if (file != NULL) {
+        fputs(content, file);
+        fclose(file);
+    }
+}
+
+/* Build a directory tree of the given depth and fanout */
+static void mktree(const char *dir, int depth, int fanout)
+{
+    char path[PATH_MAX];
+    int x;
+
+    if (depth == 0) {
+        mkfile(dir, "classes.jar", "");
+        return;
+    }
+    for (x = 0; x < fanout; x++) {
+        snprintf(path, sizeof(path), "%s/d%d", dir, x);
+        mkdir(path, 0700);
+        mktree(path, depth - 1, fanout);
+    }
+}
+
+static int rmentry(const char *path, const struct stat *st, int flag,
+                   struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+/* Remove the JAVA_HOME tree, children first */
+static void rmtree(void)
+{
+    if (tree[0] != '\0' && nftw(tree, rmentry, 16, FTW_DEPTH | FTW_PHYS) != 0)
+        log_error("Cannot remove %s: %s", tree, strerror(errno));
+    tree[0] = '\0';
+}
+
+/* Build a JAVA_HOME looking like a JDK, but bigger */
+static void home_setup(int depth, int fanout)
+{
+    char path[PATH_MAX];
+
+    rmtree();
+    strcpy(tree, "/tmp/deimos-bench.XXXXXX");
+    if (mkdtemp(tree) == NULL) {
+        log_error("Cannot create temporary directory");
+        exit(1);
+    }
+    mktree(tree, depth, fanout);
+
+    /* jvm.cfg and libjvm.so live in lib, like in a JDK */
+    snprintf(path, sizeof(path), "%s/lib", tree);
+    mkdir(path, 0700);
+    mkfile(path, "jvm.cfg", "-server KNOWN\n-client IGNORE\n-hotspot ERROR\n"
+                            "-classic WARN\n-native ERROR\n-green ERROR\n");
+    snprintf(path, sizeof(path), "%s/lib/server", tree);
+    mkdir(path, 0700);
+    mkfile(path, "libjvm.so", "");
+    snprintf(path, sizeof(path), "%s/lib", tree);
+    mkfile(path, "a.jar", "");
+    mkfile(path, "b.jar", "");
+}
+
+static void home_jdk_setup(void)
+{
+    /* About the size of a JDK 8 (~500 directories) */
+    home_setup(4, 4);
+}
+
+static void home_deep_setup(void)
+{
+    home_setup(6, 4);
+}
+
+/* home() has no release function either */
+static void release_home(home_data *data)
+{
+    int x;
+
+    if (data == NULL)
+        return;
+    for (x = 0; x < data->jnum; x++) {
+        free(data->jvms[x]->name);
+        free(data->jvms[x]->libr);
+        free(data->jvms[x]);
+    }
+    free(data->jvms);
+    free(data->cfgf);
+    free(data->path);
+    free(data);
+}
+
+static void home_run(void)
+{
+    release_home(home(tree));
+}
+
+static void location_run(void)
+{
+    free(find_location_jvm_default(tree));
+}
+
+static const bench benchmarks[] = {
+    { "replace/grow",       replace_grow_setup,   replace_grow_run },
+    { "replace/shrink",     NULL,                 replace_shrink_run },
+    { "arguments/options",  NULL,                 options_run },
+    { "home/jdk",           home_jdk_setup,       home_run },
+    { "location/jdk",       NULL,                 location_run },
+    { "arguments/cp100",    classpath_100_setup,  classpath_run },
+    { "arguments/cp2000",   classpath_2000_setup, classpath_run },
+    { "home/deep",          home_deep_setup,      home_run },
+    { "location/deep",      NULL,                 location_run },
+    { NULL, NULL, NULL }
+};
+
+static bool selected(const char *name, int argc, char *argv[], int first)
+{
+    int x;
+
+    if (first >= argc)
+        return true;
+    for (x = first; x < argc; x++) {
+        if (strncmp(name, argv[x], strlen(argv[x])) == 0)
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long long mintime = 500000000ULL;
+    int first = 1;
+    int x;
+
+    if (argc > 2 && strcmp(argv[1], "-time") == 0) {
+        mintime = strtoull(argv[2], NULL, 10) * 1000000ULL;
+        first = 3;
+    }
+
+    printf("%-20s %12s %14s %12s %14s\n",
+           "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+    for (x = 0; benchmarks[x].name != NULL; x++) {
+        const bench *b = &benchmarks[x];
+        unsigned long long start, elapsed = 0;
+        unsigned long iterations = 1, n;
+
+        /* Setups are run even for skipped benchmarks: following ones
+         * depend on them */
+        if (b->setup != NULL)
+            b->setup();
+        if (!selected(b->name, argc, argv, first))
+            continue;
+
+        /* Warm up and calibrate the number of iterations */
+        b->run();
+        while (1) {
+            start = now();
+            for (n = 0; n < iterations; n++)
+                b->run();
+            elapsed = now() - start;
+            if (elapsed >= mintime / 10)
+                break;
+            iterations *= 2;
+        }
+        iterations = (unsigned long)(iterations * (double)mintime / elapsed) + 1;
+
+        allocs = 0;
+        allocated = 0;
+        counting = true;
+        start = now();
+        for (n = 0; n < iterations; n++)
+            b->run();
+        elapsed = now() - start;
+        counting = false;
+
+        printf("%-20s %12lu %14.1f %12.1f %14.1f\n", b->name, iterations,
+               (double)elapsed / iterations, (double)allocs / iterations,
+               (double)allocated / iterations);
+        fflush(stdout);
+    }
+
+    rmtree();
+    return 0;
+}
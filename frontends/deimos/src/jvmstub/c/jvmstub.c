@@ -0,0 +1,705 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stub Java Virtual Machine library.
+ *
+ * This library exports JNI_CreateJavaVM and the subset of the JNI function
+ * table used by deimos, and simulates the behaviour of the embedded
+ * BackgroundWrapper. It allows to test and benchmark the native control
+ * paths of deimos (controller, signal handlers, logger...) without the cost
+ * of a real JVM.
+ *
+ * Every step of the lifecycle can be scripted with a JVM option
+ *     -Djvmstub.<step>=<action>[+<action>...]
+ * or, for all the JVMs created by a controller, with the JVMSTUB environment
+ * variable ("<step>=<actions>;<step>=<actions>...").
+ *
+ * Steps are create, bootstrap, load, check, resume, pause, destroy, exit,
+ * version, reload and hibernate. Actions are:
+ *     delay:<ms>      sleep before going on
+ *     fail            make the step fail
+ *     crash[:<sig>]   kill the process with a signal (default SIGKILL)
+ *     abort           call the "abort" hook given by the launcher
+ *     exit:<code>     terminate the process with an exit code
+ *     hang            never return
+ *     print:<lines>   write lines on stdout
+ *     reload:<ms>     call the native shutdown(true) after ms milliseconds
+ *     shutdown:<ms>   call the native shutdown(false) after ms milliseconds
+ *     failed:<ms>     call the native failed(message) after ms milliseconds
+ *     threads:<count> start idle threads named "stub-<n>", like JVM threads
+ * An action can be prefixed by "<percent>%" to only happen randomly.
+ *
+ * "-Djvmstub.verbose=true" traces the steps on stderr, and
+ * "-Djvmstub.events=<file>" appends a "<epoch ms> <pid> <step>" line to a
+ * file at the start of every step, so that a test driving several
+ * launchers can order what their JVMs did.
+ */
+
+#include <jni.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+
+#define STUB_PREFIX "-Djvmstub."
+#define STUB_LINE   "jvmstub: the quick brown fox jumps over the lazy dog, " \
+                    "the quick brown fox jumps over the lazy dog"
+
+enum {
+    STEP_CREATE,
+    STEP_BOOTSTRAP,
+    STEP_LOAD,
+    STEP_CHECK,
+    STEP_RESUME,
+    STEP_PAUSE,
+    STEP_DESTROY,
+    STEP_EXIT,
+    STEP_VERSION,
+    STEP_RELOAD,
+    STEP_HIBERNATE,
+    STUB_STEPS
+};
+
+static const char *steps[STUB_STEPS] = {
+    "create", "bootstrap", "load", "check", "resume", "pause", "destroy",
+    "exit", "version", "reload", "hibernate"
+};
+
+/* The script of every step */
+static char *script[STUB_STEPS];
+
+/* Hook called when the JVM aborts */
+static void (*abort_hook)(void) = NULL;
+
+/* Native methods registered by the launcher */
+typedef void (*shutdown_t)(JNIEnv *, jobject, jboolean);
+typedef void (*failed_t)(JNIEnv *, jobject, jstring);
+static shutdown_t native_shutdown = NULL;
+static failed_t   native_failed   = NULL;
+
+static unsigned int seed;
+static int verbose = 0;
+static char *events = NULL;
+static int pending_exception = 0;
+
+/* Every object handle points to one of those */
+typedef struct {
+    const char *kind;
+    const char *name;
+} stub_object;
+
+static stub_object loader_class  = { "class", "io/zatarox/satellite/impl/EmbeddedClassLoader" };
+static stub_object wrapper_class = { "class", "io/zatarox/satellite/impl/BackgroundWrapper" };
+static stub_object wrapper       = { "object", "BackgroundWrapper" };
+static stub_object bytes         = { "array", "byte[]" };
+static stub_object strings       = { "array", "String[]" };
+static stub_object throwable     = { "object", "Throwable" };
+static stub_object message       = { "string", "jvmstub failure" };
+static stub_object instance      = { "object", "Object" };
+
+static JNIEnv stub_env;
+static JavaVM stub_vm;
+
+static void trace(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (!verbose)
+        return;
+    va_start(ap, fmt);
+    fprintf(stderr, "jvmstub[%d]: ", (int)getpid());
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    fflush(stderr);
+    va_end(ap);
+}
+
+/* Append a step to the events file, with one O_APPEND write per line */
+static void event(const char *step)
+{
+    struct timespec ts;
+    char line[128];
+    int fd, len;
+
+    if (events == NULL)
+        return;
+    fd = open(events, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0)
+        return;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    len = snprintf(line, sizeof(line), "%lld %d %s\n",
+                   (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000,
+                   (int)getpid(), step);
+    if (write(fd, line, len) != len)
+        trace("events: %s", strerror(errno));
+    close(fd);
+}
+
+static int step_index(const char *name, size_t len)
+{
+    int x;
+
+    for (x = 0; x < STUB_STEPS; x++) {
+        if (strlen(steps[x]) == len && strncmp(steps[x], name, len) == 0)
+            return x;
+    }
+    return -1;
+}
+
+/* Parse a "<step>=<actions>" definition */
+static void define(const char *def)
+{
+    const char *eq = strchr(def, '=');
+    int x;
+
+    if (eq == NULL)
+        return;
+    x = step_index(def, eq - def);
+    if (x < 0) {
+        if (strncmp(def, "verbose", eq - def) == 0)
+            verbose = strcmp(eq + 1, "true") == 0;
+        else if (strncmp(def, "events", eq - def) == 0) {
+            free(events);
+            events = strdup(eq + 1);
+        }
+        else
+            fprintf(stderr, "jvmstub: unknown step in %s\n", def);
+        return;
+    }
+    free(script[x]);
+    script[x] = strdup(eq + 1);
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec  = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
+typedef struct {
+    long delay;
+    int  kind;
+} later_data;
+
+/* Simulates a call from an application thread to the controller */
+static void *later(void *arg)
+{
+    later_data *data = (later_data *)arg;
+
+    sleep_ms(data->delay);
+    trace("calling native %s", data->kind == 2 ? "failed" :
+          data->kind ? "shutdown(true)" : "shutdown(false)");
+    if (data->kind == 2) {
+        if (native_failed != NULL)
+            native_failed(&stub_env, (jobject)&wrapper, (jstring)&message);
+    }
+    else if (native_shutdown != NULL) {
+        native_shutdown(&stub_env, (jobject)&wrapper,
+                        data->kind ? JNI_TRUE : JNI_FALSE);
+    }
+    free(data);
+    return NULL;
+}
+
+static void schedule(long delay, int kind)
+{
+    pthread_t thread;
+    later_data *data = (later_data *)malloc(sizeof(later_data));
+
+    data->delay = delay;
+    data->kind  = kind;
+    if (pthread_create(&thread, NULL, later, data) == 0)
+        pthread_detach(thread);
+}
+
+/* Simulates a JVM service thread (GC, compiler...) */
+static void *idle(void *arg)
+{
+    char name[16];
+
+    snprintf(name, sizeof(name), "stub-%ld", (long)arg);
+    prctl(PR_SET_NAME, name, 0, 0, 0);
+    for (;;)
+        pause();
+    return NULL;
+}
+
+static void start_threads(long count)
+{
+    static long started = 0;
+    pthread_t thread;
+
+    for (; count > 0; count--) {
+        if (pthread_create(&thread, NULL, idle, (void *)started++) == 0)
+            pthread_detach(thread);
+    }
+}
+
+/* Play the script of a step, return JNI_FALSE if the step must fail */
+static jboolean play(int x)
+{
+    char *copy, *action, *save = NULL;
+    jboolean result = JNI_TRUE;
+
+    if (x < 0 || x >= STUB_STEPS)
+        return JNI_TRUE;
+    trace("%s", steps[x]);
+    event(steps[x]);
+    if (script[x] == NULL)
+        return JNI_TRUE;
+    copy = strdup(script[x]);
+    for (action = strtok_r(copy, "+", &save); action != NULL;
+         action = strtok_r(NULL, "+", &save)) {
+        char *arg = strchr(action, '%');
+        long  val;
+
+        if (arg != NULL) {
+            /* Random action */
+            if ((rand_r(&seed) % 100) >= atoi(action))
+                continue;
+            action = arg + 1;
+        }
+        arg = strchr(action, ':');
+        val = arg == NULL ? 0 : atol(arg + 1);
+        trace("%s: %s", steps[x], action);
+
+        if (strncmp(action, "delay", 5) == 0)
+            sleep_ms(val);
+        else if (strcmp(action, "fail") == 0)
+            result = JNI_FALSE;
+        else if (strncmp(action, "crash", 5) == 0) {
+            int sig = val > 0 ? (int)val : SIGKILL;
+            signal(sig, SIG_DFL);
+            kill(getpid(), sig);
+        }
+        else if (strcmp(action, "abort") == 0) {
+            if (abort_hook != NULL)
+                abort_hook();
+            abort();
+        }
+        else if (strncmp(action, "exit", 4) == 0)
+            _exit((int)val);
+        else if (strcmp(action, "hang") == 0) {
+            for (;;)
+                pause();
+        }
+        else if (strncmp(action, "print", 5) == 0) {
+            for (; val > 0; val--)
+                puts(STUB_LINE);
+            fflush(stdout);
+        }
+        else if (strncmp(action, "reload", 6) == 0)
+            schedule(val, 1);
+        else if (strncmp(action, "shutdown", 8) == 0)
+            schedule(val, 0);
+        else if (strncmp(action, "failed", 6) == 0)
+            schedule(val, 2);
+        else if (strncmp(action, "threads", 7) == 0)
+            start_threads(val);
+        else
+            fprintf(stderr, "jvmstub: unknown action %s\n", action);
+    }
+    free(copy);
+    return result;
+}
+
+/* Method identifiers are the index of the step (plus one) they play */
+static jmethodID method_id(const char *name)
+{
+    int x = step_index(name, strlen(name));
+
+    if (x < 0) {
+        if (strcmp(name, "createBootstrap") == 0)
+            x = STEP_BOOTSTRAP;
+        else
+            x = STUB_STEPS;
+    }
+    return (jmethodID)(long)(x + 1);
+}
+
+static int method_step(jmethodID method)
+{
+    return (int)(long)method - 1;
+}
+
+static jclass JNICALL DefineClass(JNIEnv *env, const char *name, jobject loader,
+                                  const jbyte *buf, jsize len)
+{
+    return (jclass)&loader_class;
+}
+
+static jclass JNICALL FindClass(JNIEnv *env, const char *name)
+{
+    static stub_object classes[16];
+    static int count = 0;
+    int x;
+
+    for (x = 0; x < count; x++) {
+        if (strcmp(classes[x].name, name) == 0)
+            return (jclass)&classes[x];
+    }
+    if (count == 16)
+        return NULL;
+    classes[count].kind = "class";
+    classes[count].name = strdup(name);
+    return (jclass)&classes[count++];
+}
+
+static jthrowable JNICALL ExceptionOccurred(JNIEnv *env)
+{
+    return pending_exception ? (jthrowable)&throwable : NULL;
+}
+
+static void JNICALL ExceptionDescribe(JNIEnv *env)
+{
+    if (pending_exception)
+        fprintf(stderr, "jvmstub: simulated exception\n");
+}
+
+static void JNICALL ExceptionClear(JNIEnv *env)
+{
+    pending_exception = 0;
+}
+
+static jboolean JNICALL ExceptionCheck(JNIEnv *env)
+{
+    return pending_exception ? JNI_TRUE : JNI_FALSE;
+}
+
+static jobject JNICALL NewGlobalRef(JNIEnv *env, jobject obj)
+{
+    return obj;
+}
+
+static void JNICALL DeleteRef(JNIEnv *env, jobject obj)
+{
+}
+
+static jclass JNICALL GetObjectClass(JNIEnv *env, jobject obj)
+{
+    return obj == (jobject)&wrapper ? (jclass)&wrapper_class : (jclass)obj;
+}
+
+static jmethodID JNICALL GetMethodID(JNIEnv *env, jclass clazz,
+                                     const char *name, const char *sig)
+{
+    return method_id(name);
+}
+
+static jboolean JNICALL CallBooleanMethod(JNIEnv *env, jobject obj,
+                                          jmethodID method, ...)
+{
+    int x = method_step(method);
+
+    if (x >= STUB_STEPS)
+        return JNI_FALSE;
+    return play(x);
+}
+
+static void JNICALL CallVoidMethod(JNIEnv *env, jobject obj,
+                                   jmethodID method, ...)
+{
+    va_list ap;
+    int x = method_step(method);
+
+    if (x == STEP_EXIT) {
+        /* System.exit(int) */
+        jint code;
+        va_start(ap, method);
+        code = va_arg(ap, jint);
+        va_end(ap);
+        play(x);
+        trace("exit(%d)", code);
+        fflush(stdout);
+        exit(code);
+    }
+    else if (x == STEP_VERSION) {
+        play(x);
+        printf("jvmstub version \"0.0\"\n");
+        fflush(stdout);
+    }
+    else if (x >= 0 && x < STUB_STEPS)
+        play(x);
+    else if (obj == (jobject)&throwable)
+        ExceptionDescribe(env);
+}
+
+static jobject JNICALL NewObject(JNIEnv *env, jclass clazz, jmethodID method, ...)
+{
+    return (jobject)&instance;
+}
+
+static jfieldID JNICALL GetFieldID(JNIEnv *env, jclass clazz,
+                                   const char *name, const char *sig)
+{
+    return (jfieldID)&instance;
+}
+
+/* FileDescriptor.fd of the listening sockets handed to the service */
+static void JNICALL SetIntField(JNIEnv *env, jobject obj, jfieldID field,
+                                jint value)
+{
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+
+    if (getsockopt(value, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) != 0 ||
+        !listening) {
+        fprintf(stderr, "jvmstub: fd %d is not a listening socket\n", (int)value);
+        pending_exception = 1;
+    }
+    else
+        trace("listening socket %d", (int)value);
+}
+
+static jfieldID JNICALL GetStaticFieldID(JNIEnv *env, jclass clazz,
+                                         const char *name, const char *sig)
+{
+    return (jfieldID)&instance;
+}
+
+static jobject JNICALL GetStaticObjectField(JNIEnv *env, jclass clazz,
+                                            jfieldID field)
+{
+    return (jobject)&instance;
+}
+
+static jmethodID JNICALL GetStaticMethodID(JNIEnv *env, jclass clazz,
+                                           const char *name, const char *sig)
+{
+    return method_id(name);
+}
+
+static jobject JNICALL CallStaticObjectMethod(JNIEnv *env, jclass clazz,
+                                              jmethodID method, ...)
+{
+    /* EmbeddedClassLoader.createBootstrap(byte[]) */
+    if (play(method_step(method)) != JNI_TRUE) {
+        pending_exception = 1;
+        return NULL;
+    }
+    return (jobject)&wrapper;
+}
+
+static void JNICALL CallStaticVoidMethod(JNIEnv *env, jclass clazz,
+                                         jmethodID method, ...)
+{
+    play(method_step(method));
+}
+
+static jstring JNICALL NewStringUTF(JNIEnv *env, const char *utf)
+{
+    stub_object *str = (stub_object *)malloc(sizeof(stub_object));
+
+    str->kind = "string";
+    str->name = strdup(utf);
+    return (jstring)str;
+}
+
+static const char *JNICALL GetStringUTFChars(JNIEnv *env, jstring str,
+                                             jboolean *isCopy)
+{
+    if (isCopy != NULL)
+        *isCopy = JNI_FALSE;
+    return ((stub_object *)str)->name;
+}
+
+static void JNICALL ReleaseStringUTFChars(JNIEnv *env, jstring str,
+                                          const char *chars)
+{
+}
+
+static jsize JNICALL GetArrayLength(JNIEnv *env, jarray array)
+{
+    return 0;
+}
+
+static jobjectArray JNICALL NewObjectArray(JNIEnv *env, jsize len,
+                                           jclass clazz, jobject init)
+{
+    return (jobjectArray)&strings;
+}
+
+static jobject JNICALL GetObjectArrayElement(JNIEnv *env, jobjectArray array,
+                                             jsize index)
+{
+    return NULL;
+}
+
+static void JNICALL SetObjectArrayElement(JNIEnv *env, jobjectArray array,
+                                          jsize index, jobject val)
+{
+}
+
+static jbyteArray JNICALL NewByteArray(JNIEnv *env, jsize len)
+{
+    return (jbyteArray)&bytes;
+}
+
+static void JNICALL SetByteArrayRegion(JNIEnv *env, jbyteArray array,
+                                       jsize start, jsize len,
+                                       const jbyte *buf)
+{
+}
+
+static jint JNICALL RegisterNatives(JNIEnv *env, jclass clazz,
+                                    const JNINativeMethod *methods,
+                                    jint nMethods)
+{
+    jint x;
+
+    for (x = 0; x < nMethods; x++) {
+        if (strcmp(methods[x].name, "shutdown") == 0)
+            native_shutdown = (shutdown_t)methods[x].fnPtr;
+        else if (strcmp(methods[x].name, "failed") == 0)
+            native_failed = (failed_t)methods[x].fnPtr;
+    }
+    return JNI_OK;
+}
+
+static jint JNICALL GetJavaVM(JNIEnv *env, JavaVM **vm)
+{
+    *vm = &stub_vm;
+    return JNI_OK;
+}
+
+static jint JNICALL DestroyJavaVM(JavaVM *vm)
+{
+    play(STEP_DESTROY);
+    return JNI_OK;
+}
+
+static jint JNICALL AttachCurrentThread(JavaVM *vm, void **penv, void *args)
+{
+    *penv = &stub_env;
+    return JNI_OK;
+}
+
+static jint JNICALL DetachCurrentThread(JavaVM *vm)
+{
+    return JNI_OK;
+}
+
+static jint JNICALL GetEnv(JavaVM *vm, void **penv, jint version)
+{
+    *penv = &stub_env;
+    return JNI_OK;
+}
+
+static const struct JNINativeInterface_ stub_functions = {
+    .DefineClass            = DefineClass,
+    .FindClass              = FindClass,
+    .ExceptionOccurred      = ExceptionOccurred,
+    .ExceptionDescribe      = ExceptionDescribe,
+    .ExceptionClear         = ExceptionClear,
+    .ExceptionCheck         = ExceptionCheck,
+    .NewGlobalRef           = NewGlobalRef,
+    .DeleteLocalRef         = DeleteRef,
+    .GetObjectClass         = GetObjectClass,
+    .GetMethodID            = GetMethodID,
+    .CallBooleanMethod      = CallBooleanMethod,
+    .CallVoidMethod         = CallVoidMethod,
+    .NewObject              = NewObject,
+    .GetFieldID             = GetFieldID,
+    .SetIntField            = SetIntField,
+    .GetStaticFieldID       = GetStaticFieldID,
+    .GetStaticObjectField   = GetStaticObjectField,
+    .GetStaticMethodID      = GetStaticMethodID,
+    .CallStaticObjectMethod = CallStaticObjectMethod,
+    .CallStaticVoidMethod   = CallStaticVoidMethod,
+    .NewStringUTF           = NewStringUTF,
+    .GetStringUTFChars      = GetStringUTFChars,
+    .ReleaseStringUTFChars  = ReleaseStringUTFChars,
+    .GetArrayLength         = GetArrayLength,
+    .NewObjectArray         = NewObjectArray,
+    .GetObjectArrayElement  = GetObjectArrayElement,
+    .SetObjectArrayElement  = SetObjectArrayElement,
+    .NewByteArray           = NewByteArray,
+    .SetByteArrayRegion     = SetByteArrayRegion,
+    .RegisterNatives        = RegisterNatives,
+    .GetJavaVM              = GetJavaVM
+};
+
+static const struct JNIInvokeInterface_ stub_invoke = {
+    .DestroyJavaVM       = DestroyJavaVM,
+    .AttachCurrentThread = AttachCurrentThread,
+    .DetachCurrentThread = DetachCurrentThread,
+    .GetEnv              = GetEnv
+};
+
+JNIEXPORT jint JNICALL JNI_GetDefaultJavaVMInitArgs(void *args)
+{
+    ((JavaVMInitArgs *)args)->version = JNI_VERSION_1_6;
+    return JNI_OK;
+}
+
+JNIEXPORT jint JNICALL JNI_CreateJavaVM(JavaVM **pvm, void **penv, void *args)
+{
+    JavaVMInitArgs *init = (JavaVMInitArgs *)args;
+    char *env = getenv("JVMSTUB");
+    jint x;
+
+    seed = (unsigned int)(time(NULL) ^ getpid());
+
+    /* Environment first, so that JVM options win */
+    if (env != NULL) {
+        char *copy = strdup(env);
+        char *def, *save = NULL;
+        for (def = strtok_r(copy, ";", &save); def != NULL;
+             def = strtok_r(NULL, ";", &save))
+            define(def);
+        free(copy);
+    }
+    for (x = 0; x < init->nOptions; x++) {
+        const char *opt = init->options[x].optionString;
+        if (strncmp(opt, STUB_PREFIX, sizeof(STUB_PREFIX) - 1) == 0)
+            define(opt + sizeof(STUB_PREFIX) - 1);
+        else if (strcmp(opt, "abort") == 0)
+            abort_hook = (void (*)(void))init->options[x].extraInfo;
+    }
+
+    stub_env = &stub_functions;
+    stub_vm  = &stub_invoke;
+
+    if (play(STEP_CREATE) != JNI_TRUE)
+        return JNI_ERR;
+    *pvm  = &stub_vm;
+    *penv = &stub_env;
+    return JNI_OK;
+}
+
+JNIEXPORT jint JNICALL JNI_GetCreatedJavaVMs(JavaVM **vmBuf, jsize bufLen,
+                                             jsize *nVMs)
+{
+    *nVMs = 0;
+    if (stub_vm != NULL && bufLen > 0) {
+        vmBuf[0] = &stub_vm;
+        *nVMs = 1;
+    }
+    return JNI_OK;
+}
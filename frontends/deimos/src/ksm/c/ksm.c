@@ -0,0 +1,57 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Preloaded by deimos -ksm on kernels without PR_SET_MEMORY_MERGE (before
+ * Linux 6.4): every private anonymous mapping of the JVM (heap, metaspace,
+ * code cache, thread stacks) is made mergeable by the kernel samepage
+ * merging daemon. The heap is committed by mapping over its reservation,
+ * so each mapping is advised, not only the first one.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+typedef void *(*mmap_function)(void *, size_t, int, int, int, off_t);
+typedef void *(*mmap64_function)(void *, size_t, int, int, int, off64_t);
+
+static mmap_function real_mmap = NULL;
+static mmap64_function real_mmap64 = NULL;
+
+static void *advise(void *addr, size_t length, int flags)
+{
+    if (addr != MAP_FAILED && (flags & MAP_ANONYMOUS) && (flags & MAP_PRIVATE))
+        madvise(addr, length, MADV_MERGEABLE);
+    return addr;
+}
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+    if (real_mmap == NULL)
+        real_mmap = (mmap_function)dlsym(RTLD_NEXT, "mmap");
+    return advise(real_mmap(addr, length, prot, flags, fd, offset), length, flags);
+}
+
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off64_t offset)
+{
+    if (real_mmap64 == NULL)
+        real_mmap64 = (mmap64_function)dlsym(RTLD_NEXT, "mmap64");
+    return advise(real_mmap64(addr, length, prot, flags, fd, offset), length, flags);
+}
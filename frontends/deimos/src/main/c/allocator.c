@@ -0,0 +1,180 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include "deimos.h"
+#include <unistd.h>
+#include <limits.h>
+#include <malloc.h>
+#ifdef DSO_DLFCN
+#include <dlfcn.h>
+#endif
+
+/* Libraries preloaded for the allocator names, found by the dynamic linker */
+#define JEMALLOC_LIBRARY "libjemalloc.so.2"
+#define TCMALLOC_LIBRARY "libtcmalloc_minimal.so.4"
+
+/* Prepend or append a value to a list in an environment variable */
+static void extend(const char *name, const char *value, const char *separator,
+                   bool prepend)
+{
+    const char *old = getenv(name);
+    char *buf;
+
+    if (old == NULL || *old == '\0') {
+        setenv(name, value, 1);
+        return;
+    }
+    buf = (char *)malloc(strlen(old) + strlen(separator) + strlen(value) + 1);
+    if (prepend)
+        sprintf(buf, "%s%s%s", value, separator, old);
+    else
+        sprintf(buf, "%s%s%s", old, separator, value);
+    setenv(name, buf, 1);
+    free(buf);
+}
+
+bool allocator_environ(arg_data *args)
+{
+    const char *allocator = args->malloc == NULL ? "glibc" : args->malloc;
+    char buf[64];
+
+    if (strcmp(allocator, "jemalloc") == 0) {
+        extend("LD_PRELOAD", JEMALLOC_LIBRARY, ":", true);
+        /* jemalloc takes its settings from MALLOC_CONF */
+        if (args->arenas > 0) {
+            snprintf(buf, sizeof(buf), "narenas:%d", args->arenas);
+            extend("MALLOC_CONF", buf, ",", false);
+        }
+        if (args->malloctune != NULL)
+            extend("MALLOC_CONF", args->malloctune, ",", false);
+    }
+    else if (strcmp(allocator, "glibc") == 0) {
+        if (args->arenas > 0) {
+            snprintf(buf, sizeof(buf), "%d", args->arenas);
+            setenv("MALLOC_ARENA_MAX", buf, 1);
+        }
+        if (args->malloctune != NULL)
+            extend("GLIBC_TUNABLES", args->malloctune, ":", false);
+    }
+    else if (args->arenas > 0 || args->malloctune != NULL) {
+        log_error("Allocator %s has no arena or tunable settings", allocator);
+        return false;
+    }
+    else if (strcmp(allocator, "tcmalloc") == 0)
+        extend("LD_PRELOAD", TCMALLOC_LIBRARY, ":", true);
+    else {
+        if (access(allocator, R_OK) != 0) {
+            log_error("Cannot read allocator library %s", allocator);
+            return false;
+        }
+        extend("LD_PRELOAD", allocator, ":", true);
+    }
+
+    log_debug("Invoking w/ LD_PRELOAD=%s", PRINT_NULL(getenv("LD_PRELOAD")));
+    return true;
+}
+
+void allocator_preload(const char *library)
+{
+    extend("LD_PRELOAD", library, ":", true);
+    log_debug("Invoking w/ LD_PRELOAD=%s", getenv("LD_PRELOAD"));
+}
+
+/* Path of the library serving malloc(), or NULL if it cannot be known */
+static const char *active(void)
+{
+#ifdef DSO_DLFCN
+    Dl_info info;
+    void *symbol = dlsym(RTLD_DEFAULT, "malloc");
+
+    if (symbol != NULL && dladdr(symbol, &info) != 0)
+        return info.dli_fname;
+#endif
+    return NULL;
+}
+
+/* Short name of an allocator library */
+static const char *name(const char *library)
+{
+    if (library == NULL)
+        return "unknown";
+    if (strstr(library, "jemalloc") != NULL)
+        return "jemalloc";
+    if (strstr(library, "tcmalloc") != NULL)
+        return "tcmalloc";
+    if (strstr(library, "/libc.so") != NULL || strstr(library, "/libc-") != NULL)
+        return "glibc";
+    return library;
+}
+
+bool allocator_check(arg_data *args)
+{
+    const char *library = active();
+    char expected[PATH_MAX];
+    char actual[PATH_MAX];
+
+    log_debug("Running w/ allocator %s (%s)", name(library), PRINT_NULL(library));
+    if (args->malloc == NULL || library == NULL)
+        return true;
+
+    /* The dynamic linker only warns about a library it cannot preload */
+    if (strcmp(args->malloc, "glibc") == 0 || strcmp(args->malloc, "jemalloc") == 0 ||
+        strcmp(args->malloc, "tcmalloc") == 0) {
+        if (strcmp(name(library), args->malloc) == 0)
+            return true;
+    }
+    else if (realpath(args->malloc, expected) != NULL &&
+             realpath(library, actual) != NULL && strcmp(expected, actual) == 0)
+        return true;
+
+    log_error("Allocator %s is not active, malloc() comes from %s",
+              args->malloc, library);
+    return false;
+}
+
+void allocator_report(void)
+{
+    const char *arenas = getenv("MALLOC_ARENA_MAX");
+
+    status_set("malloc", "%s", name(active()));
+    if (arenas != NULL)
+        status_set("malloc_arenas", "%s", arenas);
+}
+
+void allocator_trim(void)
+{
+#ifdef DSO_DLFCN
+    int (*mallctl)(const char *, void *, size_t *, void *, size_t);
+    void (*release)(void);
+
+    /* "arena.<MALLCTL_ARENAS_ALL>.purge" */
+    mallctl = (int (*)(const char *, void *, size_t *, void *, size_t))
+              dlsym(RTLD_DEFAULT, "mallctl");
+    if (mallctl != NULL) {
+        mallctl("arena.4096.purge", NULL, NULL, NULL, 0);
+        return;
+    }
+    release = (void (*)(void))dlsym(RTLD_DEFAULT, "MallocExtension_ReleaseFreeMemory");
+    if (release != NULL) {
+        release();
+        return;
+    }
+#endif
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
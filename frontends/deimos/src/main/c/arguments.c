@@ -32,6 +32,15 @@ static char *optional(int argc, char *argv[], int argi)
     return strdup(argv[argi]);
 }
 
+/* Return the argument of a command line option taking a signed number */
+static char *signed_optional(int argc, char *argv[], int argi)
+{
+    if (argi + 1 < argc && argv[argi + 1] != NULL && argv[argi + 1][0] == '-' &&
+        argv[argi + 1][1] >= '0' && argv[argi + 1][1] <= '9')
+        return strdup(argv[argi + 1]);
+    return optional(argc, argv, argi);
+}
+
 static char *memstrcat(char *ptr, const char *str, const char *add)
 {
     size_t nl = 1;
@@ -140,6 +149,59 @@ static char* eval_cpath(const char *cp)
         return cpy;
 }
 
+/* Check a string is an integer between min and max */
+static bool in_range(const char *value, long min, long max)
+{
+    char *end;
+    long number;
+
+    if (value == NULL || *value == '\0')
+        return false;
+    number = strtol(value, &end, 10);
+    return *end == '\0' && number >= min && number <= max;
+}
+
+/* Check a scheduling policy is other, batch, idle or fifo:<1-49>[:<ms>].
+ * The real time priorities above 49 are left to the kernel threads.
+ */
+static bool valid_sched(const char *sched)
+{
+    char prio[8];
+    const char *colon;
+
+    if (sched == NULL)
+        return false;
+    if (!strcmp(sched, "other") || !strcmp(sched, "batch") || !strcmp(sched, "idle"))
+        return true;
+    if (strncmp(sched, "fifo:", 5))
+        return false;
+    sched += 5;
+    colon = strchr(sched, ':');
+    if (colon == NULL)
+        return in_range(sched, 1, 49);
+    if ((size_t)(colon - sched) >= sizeof(prio))
+        return false;
+    memcpy(prio, sched, colon - sched);
+    prio[colon - sched] = '\0';
+    return in_range(prio, 1, 49) && in_range(colon + 1, 1, 60000);
+}
+
+/* Check an I/O priority is rt, be or idle with an optional 0-7 level */
+static bool valid_ioprio(const char *ioprio)
+{
+    const char *colon;
+    size_t len;
+
+    if (ioprio == NULL)
+        return false;
+    colon = strchr(ioprio, ':');
+    len = colon == NULL ? strlen(ioprio) : (size_t)(colon - ioprio);
+    if ((len != 2 || strncmp(ioprio, "rt", 2)) && (len != 2 || strncmp(ioprio, "be", 2)) &&
+        (len != 4 || strncmp(ioprio, "idle", 4)))
+        return false;
+    return colon == NULL || in_range(colon + 1, 0, 7);
+}
+
 /* Parse command line arguments */
 static arg_data *parse(int argc, char *argv[])
 {
@@ -159,7 +221,54 @@ static arg_data *parse(int argc, char *argv[])
     args->shutdown= false;        /* Shutdown a running deimos */
     args->pause   = false;        /* Pause the running deimos */
     args->resume  = false;        /* Continue the running deimos */
+    args->status  = false;        /* Print the status of the running deimos */
+    args->restart = false;        /* Restart the running deimos */
+    args->hibernate = false;      /* Hibernate the running deimos */
+    args->freeze = false;         /* Freeze the running deimos */
     args->wait    = 0;            /* Wait until deimos has started the JVM */
+    args->rdelay  = 60;           /* Restart at most once a minute */
+    args->hotreload = false;      /* Reload by restarting the JVM */
+    args->retouch = false;        /* Let a resumed JVM fault its memory in */
+    args->switchtime = 120;       /* Roll a restart back after 2 minutes */
+    args->replicas = 1;           /* A single JVM */
+    args->standby = NULL;         /* No standby JVM */
+    args->autosize = false;       /* Don't size the JVM from the cgroup */
+    args->heappct = 60;           /* Heap, metaspace and direct memory */
+    args->metapct = 10;           /* percentages of the cgroup memory */
+    args->directpct = 10;
+    args->cgroup  = "/sys/fs/cgroup";
+    args->cpus    = NULL;         /* No CPU affinity */
+    args->numa    = NULL;         /* No NUMA memory policy */
+    args->thp     = NULL;         /* System transparent huge pages mode */
+    args->memlock = NULL;         /* Inherited RLIMIT_MEMLOCK */
+    args->mlockall = false;       /* Don't lock the JVM memory */
+    args->sched   = NULL;         /* Inherited scheduling policy */
+    args->nice    = NULL;         /* Inherited nice level */
+    args->ioprio  = NULL;         /* Inherited I/O priority */
+    args->oomscore = NULL;        /* Inherited OOM score adjustment */
+    args->tcnum   = 0;            /* No thread affinity rules */
+    args->boost   = NULL;         /* No startup nice level boost */
+    args->boostcpus = NULL;       /* No startup CPUs boost */
+    args->boosttime = 120;        /* Boost for 2 minutes at most */
+    args->lnum    = 0;            /* No listening socket */
+    args->lazy    = false;        /* Start the JVM right away */
+    args->idletime = 0;           /* Never shut an idle JVM down */
+    args->guardrss = 0;           /* No leak guard thresholds */
+    args->guardthreads = 0;
+    args->guardfds = 0;
+    args->guarduptime = 0;
+    args->guardinterval = 60;     /* Sample the JVM every minute */
+    args->guardwindow = NULL;     /* Guard restarts at any time */
+    args->guardoverlap = false;   /* Guard restarts stop the JVM first */
+    args->lease   = NULL;         /* Always active */
+    args->leasetime = 10;         /* Take a lease over after 10 seconds */
+    args->readahead = 0;          /* No readahead of the JVM files */
+    args->workingset = NULL;      /* No working set recording */
+    args->ksm     = false;        /* No memory deduplication */
+    args->ksmshim = NULL;         /* libksm.so next to deimos */
+    args->malloc  = NULL;         /* Inherited native allocator */
+    args->arenas  = 0;            /* Allocator default arenas */
+    args->malloctune = NULL;      /* Allocator default tunables */
     args->name    = NULL;         /* No VM version name */
     args->home    = NULL;         /* No default JAVA_HOME */
     args->onum    = 0;            /* Zero arguments, but let's have some room */
@@ -180,6 +289,10 @@ static arg_data *parse(int argc, char *argv[])
         return NULL;
     if (!(args->opts = (char **)malloc(argc * sizeof(char *))))
         return NULL;
+    if (!(args->threadcpus = (char **)malloc(argc * sizeof(char *))))
+        return NULL;
+    if (!(args->listen = (char **)malloc(argc * sizeof(char *))))
+        return NULL;
 
     /* Set up the command name */
     cmnd = strrchr(argv[0],'/');
@@ -273,6 +386,297 @@ static arg_data *parse(int argc, char *argv[])
                 return NULL;
             }
         }
+        else if (!strcmp(argv[x], "-restartdelay")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 0, 86400)) {
+                log_error("Invalid restart delay specified (0 to 86400)");
+                return NULL;
+            }
+            args->rdelay = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-hotreload")) {
+            args->hotreload = true;
+        }
+        else if (!strcmp(argv[x], "-retouch")) {
+            args->retouch = true;
+        }
+        else if (!strcmp(argv[x], "-switchtime")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 1, 86400)) {
+                log_error("Invalid switch time specified (1 to 86400)");
+                return NULL;
+            }
+            args->switchtime = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-replicas")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 1, 256)) {
+                log_error("Invalid replica count specified (1 to 256)");
+                return NULL;
+            }
+            args->replicas = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-standby")) {
+            args->standby = optional(argc, argv, x++);
+            if (args->standby == NULL || (strcmp(args->standby, "create") != 0 &&
+                                          strcmp(args->standby, "load") != 0)) {
+                log_error("Invalid standby mode specified (create or load)");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-autosize")) {
+            args->autosize = true;
+        }
+        else if (!strcmp(argv[x], "-autosizepct")) {
+            temp = optional(argc, argv, x++);
+            if (temp == NULL ||
+                sscanf(temp, "%d,%d,%d", &args->heappct, &args->metapct,
+                       &args->directpct) != 3 ||
+                args->heappct < 0 || args->metapct < 0 || args->directpct < 0 ||
+                args->heappct + args->metapct + args->directpct > 100) {
+                log_error("Invalid autosize percentages specified");
+                return NULL;
+            }
+            args->autosize = true;
+        }
+        else if (!strcmp(argv[x], "-cgroup")) {
+            args->cgroup = optional(argc, argv, x++);
+            if (args->cgroup == NULL) {
+                log_error("Invalid cgroup root specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-cpus")) {
+            args->cpus = optional(argc, argv, x++);
+            if (args->cpus == NULL) {
+                log_error("Invalid CPU list specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-numa")) {
+            args->numa = optional(argc, argv, x++);
+            if (args->numa == NULL) {
+                log_error("Invalid NUMA nodes specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-thp")) {
+            args->thp = optional(argc, argv, x++);
+            if (args->thp == NULL || (strcmp(args->thp, "always") &&
+                strcmp(args->thp, "madvise") && strcmp(args->thp, "never"))) {
+                log_error("Invalid transparent huge pages mode specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-memlock")) {
+            args->memlock = optional(argc, argv, x++);
+            if (args->memlock == NULL || (strcmp(args->memlock, "unlimited") &&
+                parse_size(args->memlock) == 0)) {
+                log_error("Invalid memory lock limit specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-mlockall")) {
+            args->mlockall = true;
+        }
+        else if (!strcmp(argv[x], "-sched")) {
+            args->sched = optional(argc, argv, x++);
+            if (!valid_sched(args->sched)) {
+                log_error("Invalid scheduling policy specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-nice")) {
+            args->nice = signed_optional(argc, argv, x++);
+            if (!in_range(args->nice, -20, 19)) {
+                log_error("Invalid nice level specified (-20 to 19)");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-ioprio")) {
+            args->ioprio = optional(argc, argv, x++);
+            if (!valid_ioprio(args->ioprio)) {
+                log_error("Invalid I/O priority specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-oomscore")) {
+            args->oomscore = signed_optional(argc, argv, x++);
+            if (!in_range(args->oomscore, -1000, 1000)) {
+                log_error("Invalid OOM score adjustment specified (-1000 to 1000)");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-threadcpus")) {
+            temp = optional(argc, argv, x++);
+            if (temp == NULL || strrchr(temp, '=') == NULL || temp[0] == '=' ||
+                strrchr(temp, '=')[1] == '\0') {
+                log_error("Invalid thread affinity rule specified");
+                return NULL;
+            }
+            args->threadcpus[args->tcnum++] = temp;
+        }
+        else if (!strcmp(argv[x], "-listen")) {
+            temp = optional(argc, argv, x++);
+            /* The name ends up in the colon separated LISTEN_FDNAMES */
+            if (temp == NULL || temp[0] == '=' || temp[strlen(temp) - 1] == '=' ||
+                (strchr(temp, '=') != NULL &&
+                 strcspn(temp, ":") < (size_t)(strchr(temp, '=') - temp))) {
+                log_error("Invalid listening address specified");
+                return NULL;
+            }
+            args->listen[args->lnum++] = temp;
+        }
+        else if (!strcmp(argv[x], "-lazy")) {
+            args->lazy = true;
+        }
+        else if (!strcmp(argv[x], "-idletime")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 0, 604800)) {
+                log_error("Invalid idle time specified (0 to 604800)");
+                return NULL;
+            }
+            args->idletime = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-guardrss")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 0, 16777216)) {
+                log_error("Invalid guard resident memory specified (0 to 16777216 MB)");
+                return NULL;
+            }
+            args->guardrss = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-guardthreads")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 0, 4194304)) {
+                log_error("Invalid guard thread count specified (0 to 4194304)");
+                return NULL;
+            }
+            args->guardthreads = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-guardfds")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 0, 16777216)) {
+                log_error("Invalid guard descriptor count specified (0 to 16777216)");
+                return NULL;
+            }
+            args->guardfds = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-guarduptime")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 0, 31536000)) {
+                log_error("Invalid guard uptime specified (0 to 31536000)");
+                return NULL;
+            }
+            args->guarduptime = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-guardinterval")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 1, 86400)) {
+                log_error("Invalid guard interval specified (1 to 86400)");
+                return NULL;
+            }
+            args->guardinterval = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-guardwindow")) {
+            int start, end;
+
+            args->guardwindow = optional(argc, argv, x++);
+            if (args->guardwindow == NULL ||
+                !guard_window(args->guardwindow, &start, &end)) {
+                log_error("Invalid guard window specified (HH:MM-HH:MM)");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-guardoverlap")) {
+            args->guardoverlap = true;
+        }
+        else if (!strcmp(argv[x], "-lease")) {
+            args->lease = optional(argc, argv, x++);
+            if (args->lease == NULL) {
+                log_error("Invalid lease file specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-leasetime")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 1, 3600)) {
+                log_error("Invalid lease time specified (1 to 3600)");
+                return NULL;
+            }
+            args->leasetime = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-boost")) {
+            args->boost = signed_optional(argc, argv, x++);
+            if (!in_range(args->boost, -20, 19)) {
+                log_error("Invalid boost nice level specified (-20 to 19)");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-boostcpus")) {
+            args->boostcpus = optional(argc, argv, x++);
+            if (args->boostcpus == NULL) {
+                log_error("Invalid boost CPU list specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-boosttime")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 1, 86400)) {
+                log_error("Invalid boost duration specified (1 to 86400 s)");
+                return NULL;
+            }
+            args->boosttime = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-readahead")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 0, 64)) {
+                log_error("Invalid number of readahead threads specified (0 to 64)");
+                return NULL;
+            }
+            args->readahead = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-workingset")) {
+            args->workingset = optional(argc, argv, x++);
+            if (args->workingset == NULL) {
+                log_error("Invalid working set file specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-ksm")) {
+            args->ksm = true;
+        }
+        else if (!strcmp(argv[x], "-ksmshim")) {
+            args->ksmshim = optional(argc, argv, x++);
+            if (args->ksmshim == NULL) {
+                log_error("Invalid KSM shim specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-malloc")) {
+            args->malloc = optional(argc, argv, x++);
+            if (args->malloc == NULL || (strcmp(args->malloc, "glibc") &&
+                strcmp(args->malloc, "jemalloc") && strcmp(args->malloc, "tcmalloc") &&
+                strchr(args->malloc, '/') == NULL)) {
+                log_error("Invalid allocator specified");
+                return NULL;
+            }
+        }
+        else if (!strcmp(argv[x], "-arenas")) {
+            temp = optional(argc, argv, x++);
+            if (!in_range(temp, 1, 1024)) {
+                log_error("Invalid number of arenas specified (1 to 1024)");
+                return NULL;
+            }
+            args->arenas = atoi(temp);
+        }
+        else if (!strcmp(argv[x], "-malloctune")) {
+            args->malloctune = optional(argc, argv, x++);
+            if (args->malloctune == NULL) {
+                log_error("Invalid allocator tunables specified");
+                return NULL;
+            }
+        }
         else if (!strcmp(argv[x], "-umask")) {
             temp = optional(argc, argv, x++);
             if (temp == NULL) {
@@ -295,6 +699,18 @@ static arg_data *parse(int argc, char *argv[])
         else if (!strcmp(argv[x], "resume")) {
             args->resume = true;
         }
+        else if (!strcmp(argv[x], "status")) {
+            args->status = true;
+        }
+        else if (!strcmp(argv[x], "restart")) {
+            args->restart = true;
+        }
+        else if (!strcmp(argv[x], "hibernate")) {
+            args->hibernate = true;
+        }
+        else if (!strcmp(argv[x], "freeze")) {
+            args->freeze = true;
+        }
         else if (!strcmp(argv[x], "-check")) {
             args->chck = true;
             args->dtch = false;
@@ -394,7 +810,9 @@ static arg_data *parse(int argc, char *argv[])
         }
     }
 
-    if (args->jar == NULL && !(args->shutdown | args->pause | args->resume)) {
+    if (args->jar == NULL &&
+        !(args->shutdown | args->pause | args->resume | args->status |
+          args->restart | args->hibernate | args->freeze)) {
         log_error("No main jar specified");
         return NULL;
     }
@@ -457,7 +875,55 @@ arg_data *arguments(int argc, char *argv[])
         log_debug("| Shutdown         %s", IsTrueFalse(args->shutdown));
         log_debug("| Pause:           %s", IsTrueFalse(args->pause));
         log_debug("| Resume :         %s", IsTrueFalse(args->resume));
+        log_debug("| Status:          %s", IsTrueFalse(args->status));
+        log_debug("| Restart:         %s", IsTrueFalse(args->restart));
+        log_debug("| Hibernate:       %s", IsTrueFalse(args->hibernate));
+        log_debug("| Freeze:          %s", IsTrueFalse(args->freeze));
         log_debug("| Wait:            %d", args->wait);
+        log_debug("| Restart delay:   %d", args->rdelay);
+        log_debug("| Hot reload:      %s", IsYesNo(args->hotreload));
+        log_debug("| Retouch:         %s", IsYesNo(args->retouch));
+        log_debug("| Switch time:     %d", args->switchtime);
+        log_debug("| Replicas:        %d", args->replicas);
+        log_debug("| Standby:         \"%s\"", PRINT_NULL(args->standby));
+        log_debug("| Autosize:        %s (%d%%, %d%%, %d%%)",
+                  IsEnabledDisabled(args->autosize), args->heappct,
+                  args->metapct, args->directpct);
+        log_debug("| Cgroup root:     \"%s\"", PRINT_NULL(args->cgroup));
+        log_debug("| CPUs:            \"%s\"", PRINT_NULL(args->cpus));
+        log_debug("| NUMA nodes:      \"%s\"", PRINT_NULL(args->numa));
+        log_debug("| THP mode:        \"%s\"", PRINT_NULL(args->thp));
+        log_debug("| Memory lock:     \"%s\" (mlockall %s)",
+                  PRINT_NULL(args->memlock), IsYesNo(args->mlockall));
+        log_debug("| Scheduling:      \"%s\" (nice \"%s\")",
+                  PRINT_NULL(args->sched), PRINT_NULL(args->nice));
+        log_debug("| I/O priority:    \"%s\"", PRINT_NULL(args->ioprio));
+        log_debug("| OOM score:       \"%s\"", PRINT_NULL(args->oomscore));
+        log_debug("| Thread CPUs:     %d", args->tcnum);
+        for (x = 0; x < args->tcnum; x++) {
+            log_debug("|   \"%s\"", args->threadcpus[x]);
+        }
+        log_debug("| Listen:          %d", args->lnum);
+        for (x = 0; x < args->lnum; x++) {
+            log_debug("|   \"%s\"", args->listen[x]);
+        }
+        log_debug("| Lazy start:      %s (idle time %d s)", IsYesNo(args->lazy),
+                  args->idletime);
+        log_debug("| Leak guard:      %d MB, %d threads, %d fds, %d s (every %d s)",
+                  args->guardrss, args->guardthreads, args->guardfds,
+                  args->guarduptime, args->guardinterval);
+        log_debug("| Guard restarts:  \"%s\" (overlap %s)",
+                  PRINT_NULL(args->guardwindow), IsYesNo(args->guardoverlap));
+        log_debug("| Lease:           \"%s\" (lapsing after %d s)",
+                  PRINT_NULL(args->lease), args->leasetime);
+        log_debug("| Startup boost:   \"%s\" (CPUs \"%s\", at most %d s)",
+                  PRINT_NULL(args->boost), PRINT_NULL(args->boostcpus), args->boosttime);
+        log_debug("| Readahead:       %d threads (working set \"%s\")",
+                  args->readahead, PRINT_NULL(args->workingset));
+        log_debug("| KSM:             %s (shim \"%s\")", IsYesNo(args->ksm),
+                  PRINT_NULL(args->ksmshim));
+        log_debug("| Allocator:       \"%s\" (arenas %d, tunables \"%s\")",
+                  PRINT_NULL(args->malloc), args->arenas, PRINT_NULL(args->malloctune));
         log_debug("| JVM Name:        \"%s\"", PRINT_NULL(args->name));
         log_debug("| Java Home:       \"%s\"", PRINT_NULL(args->home));
         log_debug("| PID File:        \"%s\"", PRINT_NULL(args->pidf));
@@ -477,3 +943,48 @@ arg_data *arguments(int argc, char *argv[])
     return args;
 }
 
+char *find_option(arg_data *args, const char *prefix)
+{
+    size_t len = strlen(prefix);
+    int x;
+
+    for (x = args->onum - 1; x >= 0; x--) {
+        if (strncmp(args->opts[x], prefix, len) == 0)
+            return args->opts[x];
+    }
+    return NULL;
+}
+
+bool add_option(arg_data *args, const char *option)
+{
+    char **opts = (char **)realloc(args->opts, (args->onum + 1) * sizeof(char *));
+
+    if (opts == NULL)
+        return false;
+    args->opts = opts;
+    args->opts[args->onum++] = strdup(option);
+    return true;
+}
+
+unsigned long long parse_size(const char *size)
+{
+    char *end;
+    unsigned long long value = strtoull(size, &end, 10);
+
+    if (end == size)
+        return 0;
+    switch (*end) {
+        case 'g':
+        case 'G':
+            return value << 30;
+        case 'm':
+        case 'M':
+            return value << 20;
+        case 'k':
+        case 'K':
+            return value << 10;
+        case '\0':
+            return value;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <errno.h>
+#include <dirent.h>
+#include <sys/resource.h>
+
+/* Threads started while the boost is dropped are dropped in another pass */
+#define DROP_PASSES 10
+
+bool boost_enabled(arg_data *args)
+{
+    return args->boost != NULL || args->boostcpus != NULL;
+}
+
+bool boost_apply(arg_data *args)
+{
+    if (args->boost == NULL)
+        return true;
+    if (setpriority(PRIO_PROCESS, 0, atoi(args->boost)) != 0) {
+        log_error("Cannot boost the nice level to %s: %s", args->boost,
+                  strerror(errno));
+        return false;
+    }
+    log_debug("Startup nice level boosted to %s", args->boost);
+    return true;
+}
+
+static bool seen(pid_t *tids, int count, pid_t tid)
+{
+    int x;
+
+    for (x = 0; x < count; x++) {
+        if (tids[x] == tid)
+            return true;
+    }
+    return false;
+}
+
+void boost_drop(arg_data *args, pid_t pid, long long elapsed)
+{
+    /* The steady nice level is the one of -nice, or the controller one */
+    int nice = args->nice != NULL ? atoi(args->nice) : getpriority(PRIO_PROCESS, 0);
+    pid_t *tids = NULL;
+    int count = 0, size = 0, pass, fresh;
+    struct dirent *entry;
+    char path[64];
+    pid_t tid;
+    DIR *dir;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    for (pass = 0; pass < DROP_PASSES; pass++) {
+        dir = opendir(path);
+        if (dir == NULL) {
+            log_error("Cannot list the threads of process %d", (int)pid);
+            break;
+        }
+        fresh = 0;
+        while ((entry = readdir(dir)) != NULL) {
+            tid = (pid_t)atoi(entry->d_name);
+            if (tid <= 0 || seen(tids, count, tid))
+                continue;
+            if (count == size) {
+                size = size == 0 ? 64 : size * 2;
+                tids = (pid_t *)realloc(tids, size * sizeof(pid_t));
+            }
+            tids[count++] = tid;
+            fresh++;
+
+            /* A thread may exit meanwhile */
+            if (args->boost != NULL && setpriority(PRIO_PROCESS, tid, nice) != 0 &&
+                errno != ESRCH)
+                log_error("Cannot drop the nice level of thread %d: %s",
+                          (int)tid, strerror(errno));
+            if (args->boostcpus != NULL)
+                placement_bind(args, tid);
+        }
+        closedir(dir);
+        if (fresh == 0)
+            break;
+    }
+    free(tids);
+
+    log_debug("Startup boost of process %d dropped after %lld ms (%d threads)",
+              (int)pid, elapsed, count);
+    status_set("boost_ms", "%lld", elapsed);
+}
@@ -0,0 +1,374 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <limits.h>
+#include <unistd.h>
+
+/* Limits above this value mean "unlimited" in cgroup v1 */
+#define CGROUP_V1_UNLIMITED (1ULL << 62)
+
+typedef void (*cgroup_reader)(const char *dir, cgroup_data *data);
+
+/* Read the first line of a file of a cgroup directory */
+static char *read_line(const char *dir, const char *name, char *buf, int len)
+{
+    char path[PATH_MAX];
+    FILE *file;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    file = fopen(path, "r");
+    if (file == NULL)
+        return NULL;
+    if (fgets(buf, len, file) == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    buf[strcspn(buf, "\r\n")] = '\0';
+    return buf;
+}
+
+/* Read a limit in bytes, 0 meaning unlimited */
+static unsigned long long read_limit(const char *dir, const char *name)
+{
+    char buf[64];
+    unsigned long long value;
+
+    if (read_line(dir, name, buf, sizeof(buf)) == NULL)
+        return 0;
+    if (strcmp(buf, "max") == 0 || buf[0] == '-')
+        return 0;
+    value = strtoull(buf, NULL, 10);
+    if (value >= CGROUP_V1_UNLIMITED)
+        return 0;
+    return value;
+}
+
+/* Lowest of two limits, 0 meaning unlimited */
+static unsigned long long lowest(unsigned long long a, unsigned long long b)
+{
+    if (a == 0)
+        return b;
+    if (b == 0)
+        return a;
+    return a < b ? a : b;
+}
+
+/* Count the CPUs of a list like "0-3,8,10-11" */
+static int count_cpus(const char *list)
+{
+    const char *ptr = list;
+    char *end;
+    long first, last;
+    int count = 0;
+
+    while (*ptr != '\0') {
+        first = strtol(ptr, &end, 10);
+        if (end == ptr)
+            break;
+        last = first;
+        if (*end == '-') {
+            ptr = end + 1;
+            last = strtol(ptr, &end, 10);
+        }
+        if (last >= first)
+            count += last - first + 1;
+        ptr = end;
+        if (*ptr != ',')
+            break;
+        ptr++;
+    }
+    return count;
+}
+
+/* Check if a controller is in a comma separated list of controllers */
+static bool has_controller(const char *list, const char *controller)
+{
+    size_t len = strlen(controller);
+    const char *ptr = list;
+
+    /* The unified hierarchy has no controller list */
+    if (len == 0)
+        return *list == '\0';
+    while (ptr != NULL) {
+        if (strncmp(ptr, controller, len) == 0 &&
+            (ptr[len] == ',' || ptr[len] == '\0'))
+            return true;
+        ptr = strchr(ptr, ',');
+        if (ptr != NULL)
+            ptr++;
+    }
+    return false;
+}
+
+bool cgroup_self(const char *controller, char *path, int len)
+{
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    char buf[1024];
+    char *list, *dir;
+    bool found = false;
+
+    if (file == NULL)
+        return false;
+    while (found == false && fgets(buf, sizeof(buf), file) != NULL) {
+        /* hierarchy-ID:controller-list:cgroup-path */
+        list = strchr(buf, ':');
+        if (list == NULL)
+            continue;
+        dir = strchr(++list, ':');
+        if (dir == NULL)
+            continue;
+        *dir++ = '\0';
+        dir[strcspn(dir, "\r\n")] = '\0';
+        if (has_controller(list, controller)) {
+            snprintf(path, len, "%s", dir);
+            found = true;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+/*
+ * Call a reader on the cgroup of this process and all its ancestors, up to
+ * the mount point of the hierarchy. When the cgroup of this process is not
+ * found under the mount point (a copy of the files, or a cgroup namespace)
+ * only the mount point is read.
+ */
+static void hierarchy(const char *base, const char *controller,
+                      cgroup_reader reader, cgroup_data *data)
+{
+    char dir[PATH_MAX];
+    char self[PATH_MAX];
+    size_t len = strlen(base);
+    struct stat info;
+    char *slash;
+
+    snprintf(dir, sizeof(dir), "%s", base);
+    if (cgroup_self(controller, self, sizeof(self)) && strcmp(self, "/") != 0) {
+        snprintf(dir, sizeof(dir), "%s%s", base, self);
+        if (stat(dir, &info) != 0 || !S_ISDIR(info.st_mode))
+            snprintf(dir, sizeof(dir), "%s", base);
+    }
+    while (true) {
+        reader(dir, data);
+        slash = strrchr(dir, '/');
+        if (slash == NULL || (size_t)(slash - dir) < len)
+            break;
+        *slash = '\0';
+    }
+}
+
+static void read_v2_memory(const char *dir, cgroup_data *data)
+{
+    data->memmax  = lowest(data->memmax, read_limit(dir, "memory.max"));
+    data->memhigh = lowest(data->memhigh, read_limit(dir, "memory.high"));
+}
+
+static void read_v2_cpu(const char *dir, cgroup_data *data)
+{
+    char buf[64];
+    unsigned long long quota, period = 0;
+
+    /* "$MAX $PERIOD", $MAX being "max" when unlimited */
+    if (read_line(dir, "cpu.max", buf, sizeof(buf)) == NULL)
+        return;
+    if (sscanf(buf, "%llu %llu", &quota, &period) == 2 && period > 0)
+        data->cpuquota = lowest(data->cpuquota, quota * 1000 / period);
+}
+
+static void read_v1_memory(const char *dir, cgroup_data *data)
+{
+    data->memmax  = lowest(data->memmax, read_limit(dir, "memory.limit_in_bytes"));
+    data->memhigh = lowest(data->memhigh, read_limit(dir, "memory.soft_limit_in_bytes"));
+}
+
+static void read_v1_cpu(const char *dir, cgroup_data *data)
+{
+    unsigned long long quota  = read_limit(dir, "cpu.cfs_quota_us");
+    unsigned long long period = read_limit(dir, "cpu.cfs_period_us");
+
+    if (quota > 0 && period > 0)
+        data->cpuquota = lowest(data->cpuquota, quota * 1000 / period);
+}
+
+/* The effective cpuset already accounts for the ancestors */
+static void read_cpuset(const char *dir, cgroup_data *data)
+{
+    static const char *names[] = {
+        "cpuset.cpus.effective", "cpuset.effective_cpus", "cpuset.cpus", NULL
+    };
+    char buf[1024];
+    int x;
+
+    for (x = 0; data->cpuset == 0 && names[x] != NULL; x++) {
+        if (read_line(dir, names[x], buf, sizeof(buf)) != NULL)
+            data->cpuset = count_cpus(buf);
+    }
+}
+
+bool cgroup_limits(const char *root, cgroup_data *data)
+{
+    char base[PATH_MAX];
+    struct stat info;
+
+    memset(data, 0, sizeof(cgroup_data));
+
+    /* Unified hierarchy */
+    snprintf(base, sizeof(base), "%s/cgroup.controllers", root);
+    if (stat(base, &info) == 0) {
+        data->version = 2;
+        hierarchy(root, "", read_v2_memory, data);
+        hierarchy(root, "", read_v2_cpu, data);
+        hierarchy(root, "", read_cpuset, data);
+        return true;
+    }
+
+    /* One hierarchy per controller */
+    snprintf(base, sizeof(base), "%s/memory", root);
+    if (stat(base, &info) == 0) {
+        data->version = 1;
+        hierarchy(base, "memory", read_v1_memory, data);
+    }
+    snprintf(base, sizeof(base), "%s/cpu,cpuacct", root);
+    if (stat(base, &info) != 0)
+        snprintf(base, sizeof(base), "%s/cpu", root);
+    if (stat(base, &info) == 0) {
+        data->version = 1;
+        hierarchy(base, "cpu", read_v1_cpu, data);
+    }
+    snprintf(base, sizeof(base), "%s/cpuset", root);
+    if (stat(base, &info) == 0) {
+        data->version = 1;
+        hierarchy(base, "cpuset", read_cpuset, data);
+    }
+    return data->version != 0;
+}
+
+/* Append an option and dump it */
+static void append(arg_data *args, const char *format, unsigned long long value)
+{
+    char buf[128];
+
+    snprintf(buf, sizeof(buf), format, value);
+    if (add_option(args, buf) == true)
+        log_debug("|   \"%s\"", buf);
+    else
+        log_error("Cannot add the JVM option %s", buf);
+}
+
+/* Size an option from a percentage of the memory, unless the user did */
+static void size_memory(arg_data *args, unsigned long long memory,
+                        int percent, const char *option, const char *format)
+{
+    char *user = find_option(args, option);
+    unsigned long long size = memory / 100 * percent;
+
+    if (user != NULL)
+        log_debug("|   \"%s\" (user)", user);
+    else if (percent > 0 && size >= 1ULL << 20)
+        append(args, format, size >> 20);
+}
+
+void cgroup_autosize(arg_data *args)
+{
+    cgroup_data data;
+    unsigned long long memory, heap, initial;
+    char *user;
+    int cpus, threads;
+
+    if (cgroup_limits(args->cgroup, &data) != true) {
+        log_debug("No cgroup found in %s, not sizing the JVM", args->cgroup);
+        return;
+    }
+
+    /* The JVM should stay below the throttling threshold */
+    memory = lowest(data.memmax, data.memhigh);
+    cpus = data.cpuset;
+    if (data.cpuquota > 0) {
+        threads = (int)((data.cpuquota + 999) / 1000);
+        if (cpus == 0 || threads < cpus)
+            cpus = threads;
+    }
+
+    log_debug("+-- DUMPING CGROUP LIMITS AND DERIVED JVM OPTIONS ------");
+    log_debug("| Root:            \"%s\" (v%d)", args->cgroup, data.version);
+    log_debug("| Memory max:      %llu", data.memmax);
+    log_debug("| Memory high:     %llu", data.memhigh);
+    log_debug("| CPU quota:       %llu.%03llu", data.cpuquota / 1000,
+              data.cpuquota % 1000);
+    log_debug("| Cpuset:          %d", data.cpuset);
+    log_debug("| Replicas:        %d", args->replicas);
+    log_debug("| Options:");
+
+    /* The replicas share the cgroup */
+    memory /= args->replicas;
+    if (cpus > 0) {
+        cpus /= args->replicas;
+        if (cpus < 1)
+            cpus = 1;
+    }
+
+    if (memory > 0) {
+        /* Any way of sizing the heap wins, and -Xmx can't be below -Xms */
+        user = find_option(args, "-Xmx");
+        if (user == NULL)
+            user = find_option(args, "-XX:MaxHeapSize=");
+        if (user == NULL)
+            user = find_option(args, "-XX:MaxRAM");
+        heap = memory / 100 * args->heappct;
+        if (user == NULL && find_option(args, "-Xms") != NULL) {
+            initial = parse_size(find_option(args, "-Xms") + 4);
+            if (initial > heap)
+                heap = initial;
+        }
+        if (user != NULL)
+            log_debug("|   \"%s\" (user)", user);
+        else if (args->heappct > 0 && heap >= 1ULL << 20)
+            append(args, "-Xmx%llum", heap >> 20);
+
+        size_memory(args, memory, args->metapct,
+                    "-XX:MaxMetaspaceSize=", "-XX:MaxMetaspaceSize=%llum");
+        size_memory(args, memory, args->directpct,
+                    "-XX:MaxDirectMemorySize=", "-XX:MaxDirectMemorySize=%llum");
+    }
+
+    if (cpus > 0) {
+        user = find_option(args, "-XX:ActiveProcessorCount=");
+        if (user != NULL)
+            log_debug("|   \"%s\" (user)", user);
+        else
+            append(args, "-XX:ActiveProcessorCount=%llu", cpus);
+
+        /* Same formulas as HotSpot, but from the cgroup CPUs */
+        threads = cpus <= 8 ? cpus : 8 + (cpus - 8) * 5 / 8;
+        user = find_option(args, "-XX:ParallelGCThreads=");
+        if (user != NULL)
+            log_debug("|   \"%s\" (user)", user);
+        else
+            append(args, "-XX:ParallelGCThreads=%llu", threads);
+        threads = (threads + 2) / 4;
+        if (threads < 1)
+            threads = 1;
+        user = find_option(args, "-XX:ConcGCThreads=");
+        if (user != NULL)
+            log_debug("|   \"%s\" (user)", user);
+        else
+            append(args, "-XX:ConcGCThreads=%llu", threads);
+    }
+    log_debug("+-------------------------------------------------------");
+}
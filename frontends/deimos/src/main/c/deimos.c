@@ -22,12 +22,14 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <sys/socket.h>
 #include <stdio.h>
 #include <string.h>
 #include <pwd.h>
 #include <grp.h>
 #include <syslog.h>
 #include <errno.h>
+#include <limits.h>
 #ifdef OS_LINUX
 #include <sys/prctl.h>
 #include <sys/syscall.h>
@@ -49,15 +51,35 @@ static volatile bool destroyed = false;
 static volatile bool stopped = false;
 static volatile bool started = true;
 static volatile bool doreload = false;
+static volatile bool dohotreload = false;
+static bool hotreload = false;
 static volatile bool dosignal = false;
+static volatile bool doswitch = false;  /* restart command received */
+static volatile bool dostop = false;    /* shutdown of a dormant service */
+static volatile sig_atomic_t doforward[NSIG]; /* signals for the child */
+static volatile bool dothawed = false;  /* resumed after a freeze */
+static bool hibernated = false;         /* service paused and shrunk */
+static volatile bool leased = true;     /* holding the -lease, if any */
+static bool overlapping = false;        /* child started next to another */
+static int standby_fd = -1;             /* standby end of its socket pair */
+static int standby_ctl = -1;            /* controller end of it */
+static pid_t *replicas = NULL;          /* controllers of the -replicas */
+static int replicas_count = 0;
 typedef void (*sighandler_t)(int);
 static sighandler_t handler_start  = NULL;
 static sighandler_t handler_stop  = NULL;
 static sighandler_t handler_continue  = NULL;
 static sighandler_t handler_destroy  = NULL;
+static sighandler_t handler_reload  = NULL;
+
+/* Milliseconds between two checks of the child by the controller */
+#define TICK_STARTING 10
+#define TICK_RUNNING  1000
 
 static int run_controller(arg_data *args, home_data *data, uid_t uid,
                           gid_t gid);
+static int run_replicas(arg_data *args, home_data *data, uid_t uid,
+                        gid_t gid);
 static void set_output(char *outfile, char *errfile, bool redirectstdin,
                        char *procname);
 
@@ -69,10 +91,15 @@ static void handler(int sig)
             if (started == true) {
                 log_error("Daemon already started");
             }
+            else if (leased == false) {
+                log_error("Daemon not holding the lease");
+            }
             else {
                 stopped = false;
                 java_start();
                 started = true;
+                /* Timed by the main loop, out of the signal handler */
+                dothawed = true;
             }
         break;
         case SIGUSR2:
@@ -105,7 +132,15 @@ static void handler(int sig)
             if (stopped == true) {
                 log_error("Shutdown or reload already scheduled");
             }
+            else if (hotreload == true) {
+                /* Reloaded by the main thread, out of the signal handler */
+                java_stop();
+                stopped = true;
+                dohotreload = true;
+            }
             else {
+                java_stop();
+                stopped = true;
                 destroyed = true;
                 doreload = true;
             }
@@ -440,8 +475,28 @@ static void controller(int sig)
         case SIGTERM:
         case SIGUSR1:
         case SIGUSR2:
-            log_debug("Forwarding signal %d to process %d", sig, controlled);
-            kill(controlled, sig);
+            /* A dormant service has no child to forward to */
+            if (controlled <= 0) {
+                if (sig == SIGTERM)
+                    dostop = true;
+            }
+            else {
+                /* Forwarded by the main loop, out of the signal handler:
+                   thawing the child takes stdio */
+                doforward[sig] = 1;
+            }
+            signal(sig, controller);
+        break;
+        case SIGHUP:
+            /* Started by the main loop, out of the signal handler */
+            doswitch = true;
+            signal(sig, controller);
+        break;
+        case SIGPWR:
+        case SIGTSTP:
+            /* Meant for a child: the controller only gets it while
+               dormant, when its pid is in the pid file */
+            log_debug("Caught %s, no service to act on", strsignal(sig));
             signal(sig, controller);
         break;
         default:
@@ -564,6 +619,8 @@ retry:
             pidf = fdopen(fd, "r+");
             fprintf(pidf, "%d\n", (int)getpid());
             fflush(pidf);
+            /* A longer pid may have been left by a crashed child */
+            ftruncate(fd, ftell(pidf));
             lockf(fd, F_ULOCK, 0);
             fclose(pidf);
             close(fd);
@@ -576,6 +633,29 @@ retry:
     return 0;
 }
 
+/*
+ * Atomically point the pid file to another child (overlap restart)
+ */
+static bool switch_pidf(arg_data *args, pid_t pid)
+{
+    char temp[PATH_MAX];
+    FILE *file;
+
+    snprintf(temp, sizeof(temp), "%s.tmp", args->pidf);
+    file = fopen(temp, "w");
+    if (file == NULL) {
+        log_error("Cannot write PID file %s", temp);
+        return false;
+    }
+    fprintf(file, "%d\n", (int)pid);
+    if (fclose(file) != 0 || rename(temp, args->pidf) != 0) {
+        log_error("Cannot replace PID file %s", args->pidf);
+        unlink(temp);
+        return false;
+    }
+    return true;
+}
+
 /*
  * read the pid from the pidfile
  */
@@ -645,13 +725,25 @@ static void create_tmp_file(arg_data *args)
         close(fd);
 }
 
-static void remove_tmp_file(arg_data *args)
+static bool check_child_tmp_file(pid_t pid)
 {
     char buff[80];
 
-    sprintf(buff, "/tmp/%d.deimos_up", (int)getpid());
+    sprintf(buff, "/tmp/%d.deimos_up", (int)pid);
+    return access(buff, F_OK) == 0;
+}
+
+static void remove_tmp_file(arg_data *args, pid_t pid)
+{
+    char buff[80];
+
+    sprintf(buff, "/tmp/%d.deimos_up", (int)pid);
     log_debug("remove_tmp_file: %s", buff);
     unlink(buff);
+    sprintf(buff, "/tmp/%d.deimos_hibernated", (int)pid);
+    unlink(buff);
+    sprintf(buff, "/tmp/%d.deimos_frozen", (int)pid);
+    unlink(buff);
 }
 
 /*
@@ -731,6 +823,7 @@ static int shutdown_child(arg_data *args)
         /* kill the process and wait until the pidfile has been
          * removed by the controler
          */
+        freeze_thaw(pid);
         kill(pid, SIGTERM);
         while (count > 0) {
             sleep(1);
@@ -762,7 +855,25 @@ static int child_emit(arg_data *args, int signal)
  */
 static int resume_child(arg_data *args)
 {
-    return child_emit(args, SIGUSR1);
+    int pid = get_pidf(args, false);
+    int count = 60000;
+    long latency;
+
+    if (pid <= 0 || freeze_thaw(pid) == false)
+        return child_emit(args, SIGUSR1);
+
+    /* Thawed, wait for the service to be running again */
+    kill(pid, SIGUSR1);
+    while (count-- > 0) {
+        latency = freeze_latency(pid);
+        if (latency >= 0) {
+            printf("Running %ld ms after the thaw\n", latency);
+            return 0;
+        }
+        usleep(1000);
+    }
+    log_error("Service %d was thawed but did not resume", pid);
+    return 1;
 }
 
 /*
@@ -773,6 +884,136 @@ static int pause_child(arg_data *args)
     return child_emit(args, SIGUSR2);
 }
 
+/*
+ * A lazy service waiting for a connection has no JVM, the pid file holds the
+ * pid of its controller
+ */
+static bool child_dormant(arg_data *args)
+{
+    char state[32];
+
+    return status_get(args, "state", state, sizeof(state)) &&
+           strcmp(state, "dormant") == 0;
+}
+
+/*
+ * Pause the running deimos, then freeze it
+ */
+static int freeze_child(arg_data *args)
+{
+    int pid = get_pidf(args, false);
+    int count = 600;
+
+    if (child_dormant(args)) {
+        log_error("Service dormant, no JVM to freeze");
+        return 1;
+    }
+    if (pid <= 0 || kill(pid, SIGTSTP) != 0) {
+        log_error("No service to freeze, is deimos running?");
+        return 1;
+    }
+    while (count-- > 0) {
+        usleep(100000);
+        if (freeze_frozen(pid)) {
+            printf("Service %d frozen\n", pid);
+            return 0;
+        }
+    }
+    log_error("Service %d did not freeze", pid);
+    return 1;
+}
+
+/*
+ * Hibernate the running deimos, and print the memory it gave back
+ */
+static int hibernate_child(arg_data *args)
+{
+    char path[64];
+    long before, after;
+    int count = 60;
+    FILE *file;
+    int pid = get_pidf(args, false);
+
+    if (child_dormant(args)) {
+        log_error("Service dormant, no JVM to hibernate");
+        return 1;
+    }
+    if (pid <= 0 || kill(pid, SIGPWR) != 0) {
+        log_error("No service to hibernate, is deimos running?");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "/tmp/%d.deimos_hibernated", pid);
+    while (count-- > 0) {
+        sleep(1);
+        file = fopen(path, "r");
+        if (file == NULL)
+            continue;
+        count = fscanf(file, "%ld %ld", &before, &after);
+        fclose(file);
+        if (count != 2)
+            return 1;
+        printf("Resident memory %ld kB, hibernated %ld kB\n", before, after);
+        return 0;
+    }
+    log_error("Service %d did not hibernate", pid);
+    return 1;
+}
+
+/*
+ * Restart the running deimos without a gap: the controller starts a new JVM
+ * next to the running one, and shuts the old one down once the new one is
+ * ready
+ */
+static int restart_child(arg_data *args)
+{
+    char value[32];
+    pid_t pid;
+    int switches = 0;
+
+    if (status_get(args, "controller", value, sizeof(value)) != true ||
+        (pid = atoi(value)) <= 0) {
+        log_error("No controller in %s.status, is deimos running?", args->pidf);
+        return 1;
+    }
+    if (status_get(args, "switches", value, sizeof(value)) == true)
+        switches = atoi(value);
+    if (kill(pid, SIGHUP) != 0) {
+        log_error("Cannot signal controller %d", (int)pid);
+        return 1;
+    }
+
+    /* The controller bounds the restart with its -switchtime */
+    while (kill(pid, 0) == 0) {
+        sleep(1);
+        if (status_get(args, "switches", value, sizeof(value)) != true ||
+            atoi(value) == switches ||
+            status_get(args, "switch", value, sizeof(value)) != true ||
+            strcmp(value, "starting") == 0)
+            continue;
+        if (strcmp(value, "done") == 0)
+            return 0;
+        log_error("Restart %s", value);
+        return 1;
+    }
+    log_error("Controller %d exited during the restart", (int)pid);
+    return 1;
+}
+
+/*
+ * A standby child waits for its promotion, then takes the pid file over
+ */
+static int standby_child(arg_data *args)
+{
+    bool promoted = standby_wait(standby_fd);
+
+    standby_fd = -1;
+    if (promoted != true) {
+        JVM_destroy(0);
+        return 0;
+    }
+    return check_pid(args);
+}
+
 /*
  * child process logic.
  */
@@ -780,9 +1021,33 @@ static int pause_child(arg_data *args)
 static int child(arg_data *args, home_data *data, uid_t uid, gid_t gid)
 {
     int ret = 0;
+    struct timespec timeout;
+    sigset_t waited;
+    int sig;
+    bool held;
+    bool thawing = false;
+
+    /* SIGPWR (hibernate) and SIGTSTP (freeze) are blocked in every thread,
+     * and received by the main one in its loop, out of any signal handler */
+    sigemptyset(&waited);
+    sigaddset(&waited, SIGPWR);
+    sigaddset(&waited, SIGTSTP);
+    sigprocmask(SIG_BLOCK, &waited, NULL);
+
+    /* Only the standby itself may keep the controller end of its pair */
+    if (standby_ctl >= 0) {
+        close(standby_ctl);
+        standby_ctl = -1;
+    }
 
-    /* check the pid file */
-    ret = check_pid(args);
+    /* Before anything else opens a descriptor where the sockets go */
+    if (args->vers != true && args->chck != true && listen_child(args) != true)
+        return 1;
+
+    /* check the pid file, the controller switches it after an overlap and
+     * a standby checks it once promoted */
+    if (overlapping != true && standby_fd < 0)
+        ret = check_pid(args);
     if (args->vers != true && args->chck != true) {
         if (ret == 122)
             return ret;
@@ -790,11 +1055,38 @@ static int child(arg_data *args, home_data *data, uid_t uid, gid_t gid)
             return ret;
     }
 
+    /* Raising the hard memory lock limit needs privileges */
+    if (hugepages_memlock(args) != true)
+        return 1;
+
+    /* Priorities too, before the capabilities are dropped */
+    if (priority_apply(args) != true)
+        return 1;
+    if (standby_fd < 0 && boost_apply(args) != true)
+        return 1;
+    if (ksm_apply(args) != true)
+        return 1;
+
 #ifdef OS_LINUX
     /* setuid()/setgid() only apply the current thread so we must do it now */
     if (linuxset_user_group(args->user, uid, gid) != 0)
         return 4;
 #endif
+    /* Bind the Java VM to its CPUs and memory nodes */
+    if (placement_apply(args) != true)
+        return 1;
+
+    /* Size the Java VM from the limits of its cgroup */
+    if (args->autosize == true)
+        cgroup_autosize(args);
+
+    /* Memory policies, after the heap size is known */
+    if (hugepages_apply(args) != true)
+        return 1;
+
+    /* Warm the page cache up while the Java VM is created */
+    readahead_start(args, data);
+
     /* Initialize the Java VM */
     if (java_init(args, data) != true) {
         log_debug("java_init failed");
@@ -828,6 +1120,15 @@ static int child(arg_data *args, home_data *data, uid_t uid, gid_t gid)
         return 0;
     }
 
+    /* A standby stops here with -standby create */
+    if (standby_fd >= 0 && strcmp(args->standby, "create") == 0 &&
+        (ret = standby_child(args)) != 0)
+        return ret;
+
+    /* The sockets of -listen go to the service with its context */
+    if (java_listeners() != true)
+        return 3;
+
     /* Load the service */
     if (java_load(args) != true) {
         log_debug("java_load failed");
@@ -835,6 +1136,15 @@ static int child(arg_data *args, home_data *data, uid_t uid, gid_t gid)
     }
     else
         log_debug("java_load done");
+    readahead_wait();
+
+    /* Or here, the service initialized but not resumed, with -standby load */
+    if (standby_fd >= 0 && (ret = standby_child(args)) != 0)
+        return ret;
+
+    /* The lease file may be out of reach of the user */
+    if (args->lease != NULL && lease_open(args) != true)
+        return 3;
 
     /* Downgrade user */
 #ifdef OS_LINUX
@@ -847,9 +1157,15 @@ static int child(arg_data *args, home_data *data, uid_t uid, gid_t gid)
         return 4;
 #endif
 
-    /* Start the service */
+    /* Start the service, unless waiting for the lease */
     umask(envmask);
-    if (java_start() != true) {
+    if (args->lease != NULL && lease_hold(args) != true) {
+        log_debug("Lease held by another instance, waiting for it");
+        leased = false;
+        started = false;
+        stopped = true;
+    }
+    else if (java_start() != true) {
         log_debug("java_start failed");
         return 5;
     }
@@ -860,16 +1176,96 @@ static int child(arg_data *args, home_data *data, uid_t uid, gid_t gid)
     handler_destroy = signal_set(SIGTERM, handler);
     handler_continue = signal_set(SIGUSR1, handler);
     handler_stop = signal_set(SIGUSR2, handler);
+    handler_reload = signal_set(SIGHUP, handler);
     controlled = getpid();
+    hotreload = args->hotreload;
 
     log_debug("Waiting for a signal to be delivered");
     create_tmp_file(args);
     while (!destroyed) {
-        /* pause() is not threadsafe */
-        sleep(60);
+        /* pause() is not threadsafe, and the signal may be delivered to
+         * another thread: poll for a hot reload or a resume */
+        timeout.tv_sec = hotreload || hibernated ? 1 : 60;
+        timeout.tv_nsec = 0;
+        /* Renewed four times per lapse */
+        if (args->lease != NULL) {
+            timeout.tv_sec = args->leasetime / 4;
+            timeout.tv_nsec = (args->leasetime % 4) * 250000000L;
+        }
+        /* Thawed: the resume is timed as soon as it is done */
+        if (thawing == true) {
+            timeout.tv_sec = 0;
+            timeout.tv_nsec = 1000000L;
+        }
+        sig = sigtimedwait(&waited, NULL, &timeout);
+        if (sig == SIGPWR) {
+            log_debug("Caught %s: Hibernating", strsignal(SIGPWR));
+            if (started == false || stopped == true)
+                log_error("Can't hibernate a stopped daemon");
+            else {
+                started = false;
+                stopped = true;
+                hibernated = hibernate_enter();
+            }
+        }
+        else if (sig == SIGTSTP) {
+            log_debug("Caught %s: Freezing", strsignal(SIGTSTP));
+            if (started == false || stopped == true)
+                log_error("Can't freeze a stopped daemon");
+            else {
+                started = false;
+                java_stop();
+                stopped = true;
+                freeze_enter(args);
+                thawing = true;
+            }
+        }
+        if (dothawed == true) {
+            dothawed = false;
+            thawing = false;
+            freeze_ready();
+        }
+        if (hibernated == true && started == true) {
+            hibernated = false;
+            hibernate_leave(args);
+        }
+        /* Active while holding the lease only */
+        if (args->lease != NULL && destroyed == false) {
+            held = lease_hold(args);
+            if (held == true && leased == false) {
+                log_debug("Lease taken, starting the service");
+                leased = true;
+                stopped = false;
+                java_start();
+                started = true;
+            }
+            else if (held == false && leased == true) {
+                log_error("Lease lost, pausing the service");
+                leased = false;
+                if (started == true) {
+                    started = false;
+                    java_stop();
+                    stopped = true;
+                }
+            }
+        }
+        if (dohotreload == true) {
+            dohotreload = false;
+            if (java_reload() == true && java_start() == true) {
+                stopped = false;
+                log_debug("Service reloaded in the Java VM");
+            }
+            else {
+                log_error("Cannot reload the service in the Java VM, restarting it");
+                destroyed = true;
+                doreload = true;
+            }
+        }
     }
-    remove_tmp_file(args);
+    remove_tmp_file(args, getpid());
     log_debug("Shutdown or reload requested: exiting");
+    if (args->lease != NULL)
+        lease_release();
 
     /* Stop the service */
     if (stopped != true)
@@ -1121,6 +1517,22 @@ int main(int argc, char *argv[])
     /* Stop running deimos if required */
     if (args->resume == true)
         return (resume_child(args));
+
+    /* Print the status of the running deimos */
+    if (args->status == true)
+        return (status_print(args));
+
+    /* Restart the running deimos */
+    if (args->restart == true)
+        return (restart_child(args));
+
+    /* Hibernate the running deimos */
+    if (args->hibernate == true)
+        return (hibernate_child(args));
+
+    /* Freeze the running deimos */
+    if (args->freeze == true)
+        return (freeze_child(args));
     
     /* Retrieve JAVA_HOME layout */
     data = home(args->home);
@@ -1185,6 +1597,12 @@ int main(int argc, char *argv[])
                       getenv("LD_LIBRARY_PATH"));
         }
 
+        /* The allocator is only chosen when a process starts */
+        if (allocator_environ(args) != true)
+            return 1;
+        if (ksm_environ(args) != true)
+            return 1;
+
         /* execve needs a full path */
         ret = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
         if (ret <= 0)
@@ -1200,6 +1618,8 @@ int main(int argc, char *argv[])
         return 1;
     }
     log_debug("Running w/ LD_LIBRARY_PATH=%s", getenv("LD_LIBRARY_PATH"));
+    if (allocator_check(args) != true)
+        return 1;
 #endif /* ifdef OS_LINUX */
 
     /* If we have to detach, let's do it now */
@@ -1235,7 +1655,12 @@ int main(int argc, char *argv[])
     envmask = umask(args->umask);
     set_output(args->outfile, args->errfile, args->redirectstdin, args->procname);
     log_debug("Switching umask back to %03o from %03o", envmask, args->umask);
-    res = run_controller(args, data, uid, gid);
+    if (args->replicas > 1)
+        res = run_replicas(args, data, uid, gid);
+    else
+        res = run_controller(args, data, uid, gid);
+    if (args->vers != true && args->chck != true)
+        status_remove(args);
     if (logger_pid != 0) {
         kill(logger_pid, SIGTERM);
     }
@@ -1243,32 +1668,396 @@ int main(int argc, char *argv[])
     return res;
 }
 
+/* Milliseconds of the monotonic clock */
+static long long controller_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Wait for the end of a tick, or for the death of a child */
+static void controller_tick(const sigset_t *chld, int ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec  = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    sigtimedwait(chld, NULL, &ts);
+}
+
+/* Forward the signals caught by controller() to the child, thawing it
+ * first unless it is paused again */
+static void controller_forward(void)
+{
+    static const int forwarded[] = { SIGUSR2, SIGUSR1, SIGTERM };
+    int x, sig;
+
+    for (x = 0; x < (int)(sizeof(forwarded) / sizeof(int)); x++) {
+        sig = forwarded[x];
+        if (doforward[sig] == 0)
+            continue;
+        doforward[sig] = 0;
+        if (controlled <= 0)
+            continue;
+        log_debug("Forwarding signal %d to process %d", sig, controlled);
+        if (sig != SIGUSR2)
+            freeze_thaw(controlled);
+        kill(controlled, sig);
+    }
+}
+
+/* The child created its temporary file: the service is started */
+static void controller_ready(arg_data *args, pid_t pid, long long started)
+{
+    long long elapsed = controller_now() - started;
+
+    log_debug("Service started in %lld ms", elapsed);
+    status_set("state", "running");
+    status_set("startup_ms", "%lld", elapsed);
+    placement_report(args, pid);
+    priority_report(pid);
+    allocator_report();
+    status_write(args);
+    readahead_record(args, pid);
+}
+
+/* Lazy start: no JVM until a connection comes in. Returns false when the
+ * service is shut down meanwhile */
+static bool controller_dormant(arg_data *args)
+{
+    static int wakeups = 0;
+
+    controlled = 0;
+    signal(SIGTERM, controller);
+    signal(SIGUSR1, controller);
+    signal(SIGUSR2, controller);
+    signal(SIGPWR, controller);
+    signal(SIGTSTP, controller);
+    /* The shutdown command finds the controller in the pid file */
+    switch_pidf(args, getpid());
+    status_set("state", "dormant");
+    status_set("pid", "0");
+    status_write(args);
+    log_debug("Service dormant, waiting for a connection");
+
+    while (dostop == false && listen_wait(args, TICK_RUNNING) != true)
+        ;
+    unlink(args->pidf);
+    if (dostop == true) {
+        log_debug("Dormant service shut down");
+        return false;
+    }
+    log_debug("Connection pending, starting the service");
+    status_set("state", "starting");
+    status_set("wakeups", "%d", ++wakeups);
+    return true;
+}
+
+/* Fork a standby child, which waits before resuming the service */
+static pid_t standby_fork(arg_data *args, home_data *data, uid_t uid,
+                          gid_t gid, const sigset_t *chld)
+{
+    int pair[2];
+    pid_t pid;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+        log_error("Cannot create standby socket pair: %s", strerror(errno));
+        return 0;
+    }
+    pid = fork();
+    if (pid == 0) {
+        close(pair[0]);
+        standby_fd = pair[1];
+        sigprocmask(SIG_UNBLOCK, chld, NULL);
+        exit(child(args, data, uid, gid));
+    }
+    close(pair[1]);
+    if (pid < 0) {
+        log_error("Cannot fork the standby process");
+        close(pair[0]);
+        return 0;
+    }
+    log_debug("Standby process %d started", (int)pid);
+    standby_ctl = pair[0];
+    return pid;
+}
+
+/* Release the standby child, the controller is going away */
+static void standby_stop(pid_t standby)
+{
+    if (standby == 0)
+        return;
+    close(standby_ctl);
+    standby_ctl = -1;
+    kill(standby, SIGTERM);
+    waitpid(standby, NULL, 0);
+}
+
 static int run_controller(arg_data *args, home_data *data, uid_t uid,
                           gid_t gid)
 {
     pid_t pid = 0;
-
+    pid_t next = 0;             /* new JVM of an overlap restart */
+    pid_t draining = 0;         /* old JVM shutting down after it */
+    long long nextstarted = 0;
+    long long drainstarted = 0;
+    pid_t standby = 0;          /* JVM waiting to replace a dead one */
+    long long standbyfailed = 0;
+    bool service = args->vers != true && args->chck != true;
+    bool idled = false;         /* lazy service stopped for inactivity */
+    bool guarded = false;       /* service stopped by its leak guard */
+    int guards = 0;
+    int restarts = 0;
+    int switches = 0;
+    int promotions = 0;
+    int sig;
+    sigset_t chld;
+
+    /* SIGCHLD is only received through sigtimedwait() in controller_tick() */
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, NULL);
+
+    if (service) {
+        status_set("state", "starting");
+        status_set("controller", "%d", (int)getpid());
+        /* Bound while still privileged, kept open across the restarts */
+        if (listen_open(args) != true)
+            return 1;
+        if (args->lazy == true && controller_dormant(args) != true)
+            return 0;
+    }
 
     /* We have to fork: this process will become the controller and the other
        will be the child */
-    while ((pid = fork()) != -1) {
+    while ((pid = standby != 0 ? standby : fork()) != -1) {
         time_t laststart;
+        long long started;
+        long long lastbusy = 0;
+        long long lastguard = 0;
+        const char *tripped = NULL; /* guard threshold crossed */
+        bool ready = false;
+        bool boosted = service && standby == 0 && boost_enabled(args);
         int status = 0;
         /* We forked (again), if this is the child, we go on normally */
-        if (pid == 0)
+        if (pid == 0) {
+            sigprocmask(SIG_UNBLOCK, &chld, NULL);
             exit(child(args, data, uid, gid));
+        }
+        /* Or the standby takes over, with its JVM created already */
+        if (standby != 0) {
+            log_debug("Promoting standby process %d", (int)pid);
+            standby_promote(standby_ctl);
+            standby_ctl = -1;
+            standby = 0;
+            standby_report(0);
+            status_set("standby", "0");
+            status_set("promotions", "%d", ++promotions);
+        }
         laststart = time(NULL);
+        started = controller_now();
+        if (service) {
+            status_set("pid", "%d", (int)pid);
+            status_set("started", "%ld", (long)laststart);
+            status_set("restarts", "%d", restarts);
+            status_write(args);
+        }
 
         /* We are in the controller, we have to forward all interesting signals
            to the child, and wait for it to die */
         controlled = pid;
+        /* Caught for the previous child */
+        for (sig = 0; sig < NSIG; sig++)
+            doforward[sig] = 0;
         signal(SIGHUP, controller);
         signal(SIGUSR1, controller);
         signal(SIGUSR2, controller);
         signal(SIGTERM, controller);
+        signal(SIGPWR, controller);
+        signal(SIGTSTP, controller);
+
+        while (waitpid(pid, &status, WNOHANG) != pid) {
+            controller_forward();
+            if (service && ready == false && check_child_tmp_file(pid)) {
+                ready = true;
+                if (boosted)
+                    boost_drop(args, pid, controller_now() - started);
+                boosted = false;
+                controller_ready(args, pid, started);
+            }
+            /* Bind the new threads to their CPUs */
+            if (ready && placement_threads(args, pid))
+                status_write(args);
+            if (ready && ksm_report(args, pid))
+                status_write(args);
+            if (ready && hibernate_report(pid))
+                status_write(args);
+            if (ready && freeze_report(pid))
+                status_write(args);
+            if (ready && lease_report(args, pid))
+                status_write(args);
+            /* Never boost a service that does not get ready for ever */
+            if (boosted && controller_now() - started >= args->boosttime * 1000LL) {
+                log_error("Service not ready after %d s, dropping its boost",
+                          args->boosttime);
+                boost_drop(args, pid, controller_now() - started);
+                boosted = false;
+                status_write(args);
+            }
+
+            /* Overlap restart: start the next JVM next to this one */
+            if (service && doswitch) {
+                doswitch = false;
+                status_set("switches", "%d", ++switches);
+                /* A restart in progress answers the new request too */
+                if (next != 0)
+                    log_debug("Restart already in progress");
+                else if (ready == false || draining != 0) {
+                    log_error("Service not ready or still restarting, restart refused");
+                    status_set("switch", "refused");
+                }
+                else if ((next = fork()) == 0) {
+                    sigprocmask(SIG_UNBLOCK, &chld, NULL);
+                    overlapping = true;
+                    exit(child(args, data, uid, gid));
+                }
+                else if (next < 0) {
+                    log_error("Cannot fork the new service process");
+                    status_set("switch", "failed");
+                    next = 0;
+                }
+                else {
+                    log_debug("Starting process %d next to %d", (int)next, (int)pid);
+                    nextstarted = controller_now();
+                    status_set("switch", "starting");
+                }
+                status_write(args);
+            }
+            if (next != 0 && check_child_tmp_file(next)) {
+                /* The new JVM takes the pid file over, the old one drains */
+                log_debug("Process %d ready, shutting %d down", (int)next, (int)pid);
+                switch_pidf(args, next);
+                kill(pid, SIGTERM);
+                draining = pid;
+                drainstarted = controller_now();
+                pid = next;
+                controlled = pid;
+                next = 0;
+                laststart = time(NULL);
+                started = nextstarted;
+                if (boost_enabled(args))
+                    boost_drop(args, pid, controller_now() - started);
+                status_set("pid", "%d", (int)pid);
+                status_set("started", "%ld", (long)laststart);
+                status_set("switch", "done");
+                controller_ready(args, pid, started);
+                tripped = NULL;
+            }
+            else if (next != 0 && (waitpid(next, NULL, WNOHANG) == next ||
+                     controller_now() - nextstarted >= args->switchtime * 1000LL)) {
+                /* Roll back: the old JVM never stopped serving */
+                log_error("Process %d not ready after the restart, keeping %d",
+                          (int)next, (int)pid);
+                kill(next, SIGKILL);
+                waitpid(next, NULL, 0);
+                remove_tmp_file(args, next);
+                next = 0;
+                status_set("switch", "rolled back");
+                status_write(args);
+            }
+            if (draining != 0 && waitpid(draining, NULL, WNOHANG) == draining) {
+                remove_tmp_file(args, draining);
+                draining = 0;
+            }
+            else if (draining != 0 &&
+                     controller_now() - drainstarted >= args->switchtime * 1000LL) {
+                log_error("Process %d still shutting down, killing it", (int)draining);
+                kill(draining, SIGKILL);
+                drainstarted = controller_now();
+            }
+
+            /* Back to dormant after -idletime without a connection */
+            if (ready && args->lazy && args->idletime > 0 && idled == false) {
+                if (lastbusy == 0 || listen_connections(args) > 0)
+                    lastbusy = controller_now();
+                else if (controller_now() - lastbusy >= args->idletime * 1000LL) {
+                    log_debug("Service idle for %d s, shutting it down", args->idletime);
+                    idled = true;
+                    kill(pid, SIGTERM);
+                }
+            }
 
-        while (waitpid(pid, &status, 0) != pid) {
-            /* Waith for process */
+            /* Leak guard: a planned restart once a threshold is crossed */
+            if (ready && guard_enabled(args) && guarded == false && next == 0 &&
+                draining == 0 &&
+                controller_now() - lastguard >= args->guardinterval * 1000LL) {
+                guard_data sample;
+                long uptime = (long)((controller_now() - started) / 1000);
+
+                lastguard = controller_now();
+                if (tripped == NULL && guard_sample(pid, &sample) &&
+                    (tripped = guard_check(args, &sample, uptime)) != NULL) {
+                    log_error("Leak guard: %s threshold crossed by process %d "
+                              "(rss %ld kB, %d threads, %d fds, up %ld s)",
+                              tripped, (int)pid, sample.rss, sample.threads,
+                              sample.fds, uptime);
+                    status_set("guard", "%s", tripped);
+                    status_write(args);
+                }
+                if (tripped != NULL && guard_now(args)) {
+                    log_error("Leak guard: restarting process %d (%s)", (int)pid, tripped);
+                    status_set("guard_restarts", "%d", ++guards);
+                    if (args->guardoverlap == true)
+                        doswitch = true;
+                    else {
+                        guarded = true;
+                        kill(pid, SIGTERM);
+                    }
+                    tripped = NULL;
+                }
+            }
+
+            /* Keep a standby JVM once the service is ready */
+            if (service && args->standby != NULL) {
+                if (standby != 0 && waitpid(standby, NULL, WNOHANG) == standby) {
+                    log_error("Standby process %d exited", (int)standby);
+                    close(standby_ctl);
+                    standby_ctl = -1;
+                    standby = 0;
+                    standbyfailed = controller_now();
+                    standby_report(0);
+                    status_set("standby", "0");
+                    status_write(args);
+                }
+                else if (standby == 0 && ready && next == 0 &&
+                         controller_now() - standbyfailed >= args->rdelay * 1000LL) {
+                    standby = standby_fork(args, data, uid, gid, &chld);
+                    if (standby == 0)
+                        standbyfailed = controller_now();
+                    status_set("standby", "%d", (int)standby);
+                    status_write(args);
+                }
+                if (standby != 0 && standby_report(standby))
+                    status_write(args);
+            }
+            controller_tick(&chld, ready && next == 0 ? TICK_RUNNING : TICK_STARTING);
+        }
+        /* A crashed child did not remove its own file */
+        remove_tmp_file(args, pid);
+        /* Nor does an overlap restart outlive it */
+        if (next != 0) {
+            kill(next, SIGKILL);
+            waitpid(next, NULL, 0);
+            remove_tmp_file(args, next);
+            next = 0;
+            status_set("switch", "failed");
+        }
+        if (draining != 0) {
+            waitpid(draining, NULL, 0);
+            remove_tmp_file(args, draining);
+            draining = 0;
         }
 
         /* The child must have exited cleanly */
@@ -1283,34 +2072,70 @@ static int run_controller(arg_data *args, home_data *data, uid_t uid,
             /* See java_abort123 (we use this return code to restart when the JVM aborts) */
             if (status == 123) {
                 log_debug("Reloading service");
-                /* prevent looping */
-                if (laststart + 60 > time(NULL)) {
-                    log_debug("Waiting 60 s to prevent looping");
-                    sleep(60);
+                restarts++;
+                /* A loaded standby would run the service of before the reload */
+                if (standby != 0 && strcmp(args->standby, "load") == 0) {
+                    standby_stop(standby);
+                    standby = 0;
+                    status_set("standby", "0");
+                }
+                if (service) {
+                    status_set("state", "restarting");
+                    status_write(args);
+                }
+                /* prevent looping, unless a standby is there to take over */
+                if (standby == 0 && laststart + args->rdelay > time(NULL)) {
+                    log_debug("Waiting %d s to prevent looping", args->rdelay);
+                    sleep(args->rdelay);
                 }
                 continue;
             }
             /* If the child got out with 0 he is shutting down */
+            if (status == 0 && guarded == true) {
+                /* Unless stopped by its leak guard */
+                guarded = false;
+                log_debug("Restarting service after its leak guard");
+                restarts++;
+                if (service) {
+                    status_set("state", "restarting");
+                    status_write(args);
+                }
+                continue;
+            }
             if (status == 0) {
+                /* An idle lazy service waits for the next connection */
+                if (idled == true) {
+                    idled = false;
+                    if (controller_dormant(args) == true)
+                        continue;
+                }
                 log_debug("Service shut down");
+                standby_stop(standby);
                 return 0;
             }
             /* Otherwise we don't rerun it */
             log_error("Service exit with a return value of %d", status);
+            standby_stop(standby);
             return 1;
 
         }
         else {
             if (WIFSIGNALED(status)) {
                 log_error("Service killed by signal %d", WTERMSIG(status));
-                /* prevent looping */
-                if (laststart + 60 > time(NULL)) {
-                    log_debug("Waiting 60 s to prevent looping");
-                    sleep(60);
+                restarts++;
+                if (service) {
+                    status_set("state", "restarting");
+                    status_write(args);
+                }
+                /* prevent looping, unless a standby is there to take over */
+                if (standby == 0 && laststart + args->rdelay > time(NULL)) {
+                    log_debug("Waiting %d s to prevent looping", args->rdelay);
+                    sleep(args->rdelay);
                 }
                 continue;
             }
             log_error("Service did not exit cleanly", status);
+            standby_stop(standby);
             return 1;
         }
     }
@@ -1321,6 +2146,269 @@ static int run_controller(arg_data *args, home_data *data, uid_t uid,
 
 }
 
+/* Signals of the controller of the -replicas */
+static void replicas_handler(int sig)
+{
+    int x;
+
+    switch (sig) {
+        case SIGTERM:
+        case SIGUSR1:
+        case SIGUSR2:
+            if (sig == SIGTERM)
+                dostop = true;
+            for (x = 0; x < replicas_count; x++) {
+                if (replicas[x] > 0)
+                    kill(replicas[x], sig);
+            }
+        break;
+        case SIGHUP:
+            /* Rolled by the main loop, out of the signal handler */
+            doswitch = true;
+        break;
+        default:
+            log_debug("Caught signal %d, use the pid file of a replica", sig);
+        break;
+    }
+}
+
+/* Pid file of a replica, "<pidfile>.<index>" */
+static char *replica_pidf(arg_data *args, int index)
+{
+    char *pidf = (char *)malloc(strlen(args->pidf) + 16);
+
+    if (pidf != NULL)
+        sprintf(pidf, "%s.%d", args->pidf, index);
+    return pidf;
+}
+
+/* Read a value of the status of a replica */
+static bool replica_status(arg_data *args, int index, const char *key,
+                           char *value, size_t len)
+{
+    char *pidf = args->pidf;
+    bool found;
+
+    args->pidf = replica_pidf(args, index);
+    if (args->pidf == NULL) {
+        args->pidf = pidf;
+        return false;
+    }
+    found = status_get(args, key, value, len);
+    free(args->pidf);
+    args->pidf = pidf;
+    return found;
+}
+
+/* Start the controller of a replica, running the service as deimos would
+ * without -replicas */
+static pid_t replica_fork(arg_data *args, home_data *data, uid_t uid,
+                          gid_t gid, int index)
+{
+    char value[16];
+    pid_t pid = fork();
+    int ret;
+
+    if (pid != 0) {
+        if (pid < 0)
+            log_error("Cannot fork the controller of replica %d", index);
+        else
+            log_debug("Replica %d controlled by process %d", index, (int)pid);
+        return pid < 0 ? 0 : pid;
+    }
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGUSR1, SIG_DFL);
+    signal(SIGUSR2, SIG_DFL);
+    signal(SIGHUP, SIG_DFL);
+    signal(SIGPWR, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    free(replicas);
+    replicas = NULL;
+    replicas_count = 0;
+    doswitch = false;
+    dostop = false;
+
+    args->pidf = replica_pidf(args, index);
+    if (args->pidf == NULL || placement_replica(args, index) != true)
+        exit(1);
+    snprintf(value, sizeof(value), "%d", index);
+    setenv("REPLICA_INDEX", value, 1);
+    snprintf(value, sizeof(value), "%d", args->replicas);
+    setenv("REPLICA_COUNT", value, 1);
+    status_set("replica", "%d", index);
+    ret = run_controller(args, data, uid, gid);
+    status_remove(args);
+    exit(ret);
+}
+
+/* Whether the JVM of a replica is ready */
+static bool replica_ready(arg_data *args, int index)
+{
+    char *pidf = args->pidf;
+    int pid;
+
+    args->pidf = replica_pidf(args, index);
+    if (args->pidf == NULL) {
+        args->pidf = pidf;
+        return false;
+    }
+    pid = get_pidf(args, true);
+    free(args->pidf);
+    args->pidf = pidf;
+    return pid > 0 && check_child_tmp_file(pid);
+}
+
+/*
+ * Run -replicas copies of the service, each with its own controller. The
+ * -listen sockets are opened here once, and the replicas share them. The pid
+ * file holds this process, which forwards the shutdown, pause and resume
+ * signals to all the replicas, and rolls a restart over them one at a time.
+ */
+static int run_replicas(arg_data *args, home_data *data, uid_t uid,
+                        gid_t gid)
+{
+    char value[32];
+    char before[32];
+    int rolling = -1;           /* replica being restarted */
+    int switches = 0;
+    int running = 0;
+    int ready, status, x;
+    int lastready = -1;
+    bool changed;
+    bool up = false;
+    int ret = 0;
+    pid_t pid;
+    sigset_t chld;
+
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, NULL);
+
+    /* The commands find this process in the pid file */
+    ret = check_pid(args);
+    if (ret != 0)
+        return ret < 0 ? 1 : ret;
+    replicas = (pid_t *)calloc(args->replicas, sizeof(pid_t));
+    if (replicas == NULL) {
+        log_error("Cannot allocate the replicas");
+        unlink(args->pidf);
+        return 1;
+    }
+    if (listen_open(args) != true) {
+        unlink(args->pidf);
+        return 1;
+    }
+    for (x = 0; x < args->replicas; x++) {
+        replicas[x] = replica_fork(args, data, uid, gid, x);
+        if (replicas[x] > 0)
+            running++;
+    }
+    replicas_count = args->replicas;
+    signal(SIGTERM, replicas_handler);
+    signal(SIGUSR1, replicas_handler);
+    signal(SIGUSR2, replicas_handler);
+    signal(SIGHUP, replicas_handler);
+    signal(SIGPWR, replicas_handler);
+    signal(SIGTSTP, replicas_handler);
+
+    status_set("state", "starting");
+    status_set("controller", "%d", (int)getpid());
+    status_set("replicas", "%d", args->replicas);
+    status_write(args);
+
+    while (running > 0) {
+        changed = false;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (x = 0; x < args->replicas; x++) {
+                if (replicas[x] != pid)
+                    continue;
+                replicas[x] = 0;
+                running--;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    log_error("Replica %d exited with status %d", x, status);
+                    ret = 1;
+                }
+                status_set("replicas", "%d", running);
+                changed = true;
+            }
+        }
+
+        for (x = 0, ready = 0; x < args->replicas; x++) {
+            if (replicas[x] > 0 && replica_ready(args, x))
+                ready++;
+        }
+        if (up == false && ready == args->replicas) {
+            up = true;
+            status_set("state", "running");
+            create_tmp_file(args);
+        }
+        if (ready != lastready) {
+            lastready = ready;
+            status_set("replicas_ready", "%d", ready);
+            changed = true;
+        }
+
+        /* Rolling restart: one replica after the other, each one once the
+         * previous one switched to its new JVM */
+        if (doswitch == true && dostop == false) {
+            doswitch = false;
+            if (rolling >= 0)
+                log_debug("Rolling restart already in progress");
+            else {
+                rolling = 0;
+                before[0] = '\0';
+                status_set("switches", "%d", ++switches);
+                status_set("switch", "starting");
+            }
+            changed = true;
+        }
+        while (rolling >= 0 && rolling < args->replicas && replicas[rolling] <= 0)
+            rolling++;
+        if (rolling >= args->replicas) {
+            rolling = -1;
+            status_set("switch", "done");
+            changed = true;
+        }
+        else if (rolling >= 0 && before[0] == '\0') {
+            if (replica_status(args, rolling, "switches", before, sizeof(before)) != true)
+                strcpy(before, "0");
+            log_debug("Restarting replica %d", rolling);
+            status_set("switch_replica", "%d", rolling);
+            kill(replicas[rolling], SIGHUP);
+            changed = true;
+        }
+        else if (rolling >= 0 &&
+                 replica_status(args, rolling, "switches", value, sizeof(value)) &&
+                 strcmp(value, before) != 0 &&
+                 replica_status(args, rolling, "switch", value, sizeof(value)) &&
+                 strcmp(value, "starting") != 0) {
+            if (strcmp(value, "done") == 0) {
+                rolling++;
+                before[0] = '\0';
+            }
+            else {
+                /* The replicas left keep their JVM */
+                log_error("Restart of replica %d %s, rolling restart stopped",
+                          rolling, value);
+                rolling = -1;
+                status_set("switch", "%s", value);
+            }
+            changed = true;
+        }
+        if (changed == true)
+            status_write(args);
+        controller_tick(&chld, TICK_RUNNING);
+    }
+
+    remove_tmp_file(args, getpid());
+    if (get_pidf(args, true) == getpid())
+        unlink(args->pidf);
+    free(replicas);
+    replicas = NULL;
+    replicas_count = 0;
+    return ret;
+}
+
 void main_reload(void)
 {
     log_debug("Killing self with HUP signal");
@@ -0,0 +1,263 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * The state file holds one line:
+ *     frozen <cgroup|->               written by the child before freezing
+ *     thawing <cgroup|-> <ns>         written by the thawing process
+ *     thawed <ms>                     written by the child once resumed
+ * "-" stands for SIGSTOP, and <ns> is the CLOCK_MONOTONIC time of the thaw.
+ */
+typedef struct {
+    char state[16];
+    char cgroup[PATH_MAX];
+    long long time;
+} freeze_state;
+
+static long long freeze_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Format a path into a PATH_MAX buffer, false when it does not fit */
+static bool freeze_path(char *path, const char *format, ...)
+{
+    va_list ap;
+    int len;
+
+    va_start(ap, format);
+    len = vsnprintf(path, PATH_MAX, format, ap);
+    va_end(ap);
+    if (len < 0 || len >= PATH_MAX) {
+        log_error("Path of the freezer too long: %s...", path);
+        return false;
+    }
+    return true;
+}
+
+static bool freeze_read(pid_t pid, freeze_state *state)
+{
+    char path[64];
+    FILE *file;
+    int count;
+
+    snprintf(path, sizeof(path), "/tmp/%d.deimos_frozen", (int)pid);
+    file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    state->cgroup[0] = '\0';
+    state->time = 0;
+    count = fscanf(file, "%15s", state->state);
+    if (count == 1 && strcmp(state->state, "thawed") == 0)
+        count = fscanf(file, "%lld", &state->time);
+    else if (count == 1)
+        count = fscanf(file, "%4095s %lld", state->cgroup, &state->time);
+    fclose(file);
+    return count >= 1;
+}
+
+static bool freeze_write(pid_t pid, const char *format, ...)
+{
+    char path[64];
+    char temp[64];
+    va_list ap;
+    FILE *file;
+
+    /* Renamed over, the readers never see half a line */
+    snprintf(path, sizeof(path), "/tmp/%d.deimos_frozen", (int)pid);
+    snprintf(temp, sizeof(temp), "/tmp/%d.deimos_frozen.%d", (int)pid, (int)getpid());
+    file = fopen(temp, "w");
+    if (file == NULL)
+        return false;
+    va_start(ap, format);
+    vfprintf(file, format, ap);
+    va_end(ap);
+    fclose(file);
+    return rename(temp, path) == 0;
+}
+
+/* Write a value to a file of a cgroup directory */
+static bool freeze_set(const char *dir, const char *name, const char *value)
+{
+    char path[PATH_MAX];
+    FILE *file;
+    bool result;
+
+    if (freeze_path(path, "%s/%s", dir, name) == false)
+        return false;
+    file = fopen(path, "w");
+    if (file == NULL)
+        return false;
+    result = fputs(value, file) >= 0;
+    return fclose(file) == 0 && result;
+}
+
+void freeze_enter(arg_data *args)
+{
+    char self[PATH_MAX];
+    char parent[PATH_MAX];
+    char dir[PATH_MAX];
+    char pid[16];
+    bool cgroup = false;
+
+    snprintf(pid, sizeof(pid), "%d", (int)getpid());
+    if (cgroup_self("", self, sizeof(self)) &&
+        freeze_path(parent, "%s%s", args->cgroup, strcmp(self, "/") == 0 ? "" : self) &&
+        freeze_path(dir, "%s/deimos.%s", parent, pid) &&
+        freeze_path(self, "%s/cgroup.freeze", dir)) {
+        if (mkdir(dir, 0755) == 0 || errno == EEXIST) {
+            /* The freezer is there from Linux 5.2 */
+            cgroup = access(self, F_OK) == 0 &&
+                     freeze_set(dir, "cgroup.procs", pid);
+            if (cgroup == false)
+                rmdir(dir);
+        }
+    }
+    if (cgroup == false)
+        log_debug("No cgroup freezer in \"%s\", stopping the JVM", args->cgroup);
+
+    if (freeze_write(getpid(), "frozen %s\n", cgroup ? dir : "-") == false) {
+        log_error("Cannot record the freeze of the service, not frozen");
+    }
+    else if (cgroup == false) {
+        /* Returns once continued */
+        kill(getpid(), SIGSTOP);
+    }
+    else if (freeze_set(dir, "cgroup.freeze", "1") == false) {
+        log_error("Cannot freeze cgroup \"%s\"", dir);
+        freeze_write(getpid(), "thawed 0\n");
+    }
+    /* This thread stops on its way back from the write, until thawed */
+
+    if (cgroup == true) {
+        /* Back into the cgroup of the service */
+        freeze_set(parent, "cgroup.procs", pid);
+        rmdir(dir);
+    }
+    log_debug("Service thawed");
+}
+
+bool freeze_thaw(pid_t pid)
+{
+    freeze_state state;
+    bool thawed;
+
+    if (freeze_read(pid, &state) == false || strcmp(state.state, "thawed") == 0)
+        return false;
+    if (strcmp(state.state, "frozen") == 0)
+        freeze_write(pid, "thawing %s %lld\n", state.cgroup, freeze_now());
+    if (strcmp(state.cgroup, "-") == 0)
+        thawed = kill(pid, SIGCONT) == 0;
+    else
+        thawed = freeze_set(state.cgroup, "cgroup.freeze", "0");
+    if (thawed == false)
+        log_error("Cannot thaw process %d", (int)pid);
+    return thawed;
+}
+
+bool freeze_frozen(pid_t pid)
+{
+    freeze_state state;
+    char path[PATH_MAX];
+    char line[256];
+    bool frozen = false;
+    FILE *file;
+
+    if (freeze_read(pid, &state) == false || strcmp(state.state, "frozen") != 0)
+        return false;
+    if (strcmp(state.cgroup, "-") == 0) {
+        /* State 'T', after the command in parentheses */
+        snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+        file = fopen(path, "r");
+        if (file == NULL)
+            return false;
+        if (fgets(line, sizeof(line), file) != NULL && strrchr(line, ')') != NULL)
+            frozen = strncmp(strrchr(line, ')'), ") T", 3) == 0;
+        fclose(file);
+        return frozen;
+    }
+    if (freeze_path(path, "%s/cgroup.events", state.cgroup) == false)
+        return false;
+    file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strcmp(line, "frozen 1\n") == 0)
+            frozen = true;
+    }
+    fclose(file);
+    return frozen;
+}
+
+void freeze_ready(void)
+{
+    freeze_state state;
+
+    if (freeze_read(getpid(), &state) == false || strcmp(state.state, "thawing") != 0)
+        return;
+    freeze_write(getpid(), "thawed %lld\n", (freeze_now() - state.time) / 1000000LL);
+}
+
+long freeze_latency(pid_t pid)
+{
+    freeze_state state;
+
+    if (freeze_read(pid, &state) == false || strcmp(state.state, "thawed") != 0)
+        return -1;
+    return (long)state.time;
+}
+
+bool freeze_report(pid_t pid)
+{
+    static pid_t reported = 0;
+    static char last[16] = "";
+    freeze_state state;
+
+    if (freeze_read(pid, &state) == false) {
+        if (reported == 0)
+            return false;
+        reported = 0;
+        last[0] = '\0';
+        status_set("frozen", "no");
+        return true;
+    }
+    /* Thawing is still frozen for the outside */
+    if (strcmp(state.state, "thawing") == 0)
+        strcpy(state.state, "frozen");
+    if (reported == pid && strcmp(last, state.state) == 0)
+        return false;
+    reported = pid;
+    strcpy(last, state.state);
+    if (strcmp(state.state, "frozen") == 0) {
+        status_set("frozen", "yes");
+        status_set("freezer", strcmp(state.cgroup, "-") == 0 ? "sigstop" : "cgroup");
+    }
+    else {
+        status_set("frozen", "no");
+        status_set("thaw_ready_ms", "%lld", state.time);
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <dirent.h>
+#include <time.h>
+
+bool guard_enabled(arg_data *args)
+{
+    return args->guardrss > 0 || args->guardthreads > 0 ||
+           args->guardfds > 0 || args->guarduptime > 0;
+}
+
+bool guard_sample(pid_t pid, guard_data *data)
+{
+    char path[64];
+    char line[128];
+    struct dirent *entry;
+    FILE *file;
+    DIR *dir;
+
+    data->rss = 0;
+    data->threads = 0;
+    data->fds = 0;
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "VmRSS: %ld kB", &data->rss) == 1)
+            continue;
+        sscanf(line, "Threads: %d", &data->threads);
+    }
+    fclose(file);
+
+    snprintf(path, sizeof(path), "/proc/%d/fd", (int)pid);
+    dir = opendir(path);
+    if (dir == NULL)
+        return false;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.')
+            data->fds++;
+    }
+    closedir(dir);
+    return true;
+}
+
+const char *guard_check(arg_data *args, guard_data *data, long uptime)
+{
+    if (args->guardrss > 0 && data->rss >= args->guardrss * 1024L)
+        return "rss";
+    if (args->guardthreads > 0 && data->threads >= args->guardthreads)
+        return "threads";
+    if (args->guardfds > 0 && data->fds >= args->guardfds)
+        return "fds";
+    if (args->guarduptime > 0 && uptime >= args->guarduptime)
+        return "uptime";
+    return NULL;
+}
+
+bool guard_window(const char *window, int *start, int *end)
+{
+    int h1, m1, h2, m2, len = 0;
+
+    if (sscanf(window, "%2d:%2d-%2d:%2d%n", &h1, &m1, &h2, &m2, &len) != 4 ||
+        window[len] != '\0')
+        return false;
+    if (h1 > 23 || m1 > 59 || h2 > 23 || m2 > 59 || h1 < 0 || m1 < 0 || h2 < 0 || m2 < 0)
+        return false;
+    *start = h1 * 60 + m1;
+    *end = h2 * 60 + m2;
+    return *start != *end;
+}
+
+bool guard_now(arg_data *args)
+{
+    time_t now = time(NULL);
+    struct tm local;
+    int start, end, minute;
+
+    if (args->guardwindow == NULL || !guard_window(args->guardwindow, &start, &end))
+        return true;
+    localtime_r(&now, &local);
+    minute = local.tm_hour * 60 + local.tm_min;
+    if (start < end)
+        return minute >= start && minute < end;
+    return minute >= start || minute < end;
+}
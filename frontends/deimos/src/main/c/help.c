@@ -94,6 +94,112 @@ void help(home_data *data)
     printf("    -wait <waittime>\n");
     printf("        wait waittime seconds for the service to start\n");
     printf("        waittime should multiple of 10 (min=10)\n");
+    printf("    -restartdelay <seconds>\n");
+    printf("        minimal time between two starts of a crashed or reloaded\n");
+    printf("        service (default 60, 0 restarts immediately)\n");
+    printf("    -hotreload\n");
+    printf("        reload the service in the running JVM with a fresh class\n");
+    printf("        loader, restarting the JVM only if the old one leaks\n");
+    printf("    -retouch\n");
+    printf("        touch the memory of a hibernated JVM again when it is resumed\n");
+    printf("    -switchtime <seconds>\n");
+    printf("        time given to the new JVM of a restart command to get ready\n");
+    printf("        before it is killed and the old one kept (default 120)\n");
+    printf("    -replicas <count>\n");
+    printf("        run that many JVMs of the service, each on its share of the CPUs\n");
+    printf("        and NUMA nodes, with the pid file <pidfile>.<index>\n");
+    printf("    -standby create | load\n");
+    printf("        keep a second JVM created (and the service loaded, without\n");
+    printf("        being resumed, with load) to replace a crashed one at once\n");
+    printf("    -autosize\n");
+    printf("        derive -Xmx, -XX:MaxMetaspaceSize, -XX:MaxDirectMemorySize,\n");
+    printf("        -XX:ActiveProcessorCount and the GC threads from the cgroup\n");
+    printf("        memory and CPU limits, unless specified explicitly\n");
+    printf("    -autosizepct <heap>,<metaspace>,<direct>\n");
+    printf("        percentages of the cgroup memory used by -autosize\n");
+    printf("        (default 60,10,10, implies -autosize)\n");
+    printf("    -cgroup <directory>\n");
+    printf("        mount point of the cgroup file systems (default /sys/fs/cgroup)\n");
+    printf("    -cpus <list>\n");
+    printf("        bind the JVM to a list of CPUs, like 0-3,8\n");
+    printf("    -numa <nodes> | interleave[:<nodes>]\n");
+    printf("        bind the JVM memory to NUMA nodes (and to their CPUs unless\n");
+    printf("        -cpus is given), or interleave it over nodes (all by default)\n");
+    printf("    -thp always | madvise | never\n");
+    printf("        use transparent huge pages for the heap (checking the system\n");
+    printf("        mode allows it), or disable them for the JVM\n");
+    printf("    -memlock <size> | unlimited\n");
+    printf("        raise the RLIMIT_MEMLOCK of the JVM\n");
+    printf("    -mlockall\n");
+    printf("        lock all the JVM memory in RAM (implies -memlock unlimited)\n");
+    printf("    -sched other | batch | idle | fifo:<priority>[:<ms>]\n");
+    printf("        scheduling policy of the JVM; fifo priorities go from 1 to 49\n");
+    printf("        and a thread running longer than <ms> (default 1000) without\n");
+    printf("        blocking gets the service restarted\n");
+    printf("    -nice <level>\n");
+    printf("        nice level of the JVM, from -20 to 19\n");
+    printf("    -ioprio rt | be | idle[:<level>]\n");
+    printf("        I/O scheduling class and level (0 to 7, default 4) of the JVM\n");
+    printf("    -oomscore <adjustment>\n");
+    printf("        OOM killer score adjustment of the JVM, from -1000 to 1000\n");
+    printf("    -threadcpus <pattern>=<list>\n");
+    printf("        bind the JVM threads whose name matches a pattern (like\n");
+    printf("        \"GC Thread#*\") to a list of CPUs, once the service is ready;\n");
+    printf("        names are cut to 15 characters, the first matching rule wins\n");
+    printf("    -boost <level>\n");
+    printf("        nice level of the JVM until it is ready (like -5), then -nice\n");
+    printf("    -boostcpus <list>\n");
+    printf("        CPUs the JVM runs on until it is ready, then -cpus\n");
+    printf("    -boosttime <seconds>\n");
+    printf("        maximum duration of the startup boost (default 120)\n");
+    printf("    -listen [<name>=]<address>\n");
+    printf("        listen on [<host>]:<port> in the controller, and hand the socket\n");
+    printf("        to every JVM started (LISTEN_FDS), so that connections wait in\n");
+    printf("        the accept queue while the service restarts\n");
+    printf("    -lazy\n");
+    printf("        start the JVM on the first connection to a -listen address\n");
+    printf("    -idletime <seconds>\n");
+    printf("        shut a -lazy JVM down after that long without a connection,\n");
+    printf("        until the next one (default 0, never)\n");
+    printf("    -guardrss <MB>\n");
+    printf("    -guardthreads <count>\n");
+    printf("    -guardfds <count>\n");
+    printf("        restart the JVM once its resident memory, its number of threads\n");
+    printf("        or of open descriptors reaches that value (default 0, never)\n");
+    printf("    -guarduptime <seconds>\n");
+    printf("        restart the JVM once it has run that long (default 0, never)\n");
+    printf("    -guardinterval <seconds>\n");
+    printf("        time between two samples of the JVM by the guard (default 60)\n");
+    printf("    -guardwindow <HH:MM-HH:MM>\n");
+    printf("        delay the guard restarts to that local time window\n");
+    printf("    -guardoverlap\n");
+    printf("        start the new JVM next to the old one for the guard restarts,\n");
+    printf("        as the restart command does\n");
+    printf("    -lease <file>\n");
+    printf("        run the service only while holding the lease of that file, shared\n");
+    printf("        with a standby instance which keeps its service loaded but paused\n");
+    printf("    -leasetime <seconds>\n");
+    printf("        time without a heartbeat before the lease lapses (default 10)\n");
+    printf("    -readahead <threads>\n");
+    printf("        read the JVM, its class library and the application jars into\n");
+    printf("        the page cache on that many threads while the JVM starts\n");
+    printf("    -workingset <file>\n");
+    printf("        record the file pages in the page cache once the service is\n");
+    printf("        ready, and read them ahead on the next starts (delete the file\n");
+    printf("        to record it again)\n");
+    printf("    -ksm\n");
+    printf("        let the kernel samepage merging daemon deduplicate the JVM\n");
+    printf("        memory with identical JVMs\n");
+    printf("    -ksmshim <library path>\n");
+    printf("        library preloaded by -ksm on kernels older than 6.4\n");
+    printf("        (default libksm.so next to deimos)\n");
+    printf("    -malloc glibc | jemalloc | tcmalloc | <library path>\n");
+    printf("        native allocator of the JVM, preloaded when deimos re-executes\n");
+    printf("    -arenas <count>\n");
+    printf("        maximum number of allocator arenas (glibc and jemalloc)\n");
+    printf("    -malloctune <tunables>\n");
+    printf("        glibc.malloc tunables (like glibc.malloc.trim_threshold=131072)\n");
+    printf("        or jemalloc options (like background_thread:true)\n");
     printf("    -keepstdin\n");
     printf("        does not redirect stdin to /dev/null\n");
     
@@ -104,6 +210,18 @@ void help(home_data *data)
     printf("        pause the service using the file given in the -pidfile option\n");
     printf("    resume\n");
     printf("        continue the service using the file given in the -pidfile option\n");
+    printf("    hibernate\n");
+    printf("        pause the service, shrink the Java heap and give the free native\n");
+    printf("        memory back to the system, until it is resumed\n");
+    printf("    freeze\n");
+    printf("        pause the service, then stop all the threads of the JVM with the\n");
+    printf("        cgroup freezer (or SIGSTOP) until it is resumed\n");
+    printf("    status\n");
+    printf("        print the status of the service, published next to the file\n");
+    printf("        given in the -pidfile option\n");
+    printf("    restart\n");
+    printf("        start a new JVM next to the running one, and shut the old one\n");
+    printf("        down once the new one is ready\n");
     
     printf("\nDeimos (Satellite Project) " DEIMOS_VERSION_STRING "\n");
     printf("Copyright 2017 Zatarox\n");
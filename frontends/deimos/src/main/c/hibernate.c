@@ -0,0 +1,141 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* From linux/mman.h, Linux 5.14 */
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+long hibernate_rss(pid_t pid)
+{
+    char path[64];
+    char line[128];
+    long rss = -1;
+    FILE *file;
+
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "VmRSS: %ld kB", &rss) == 1)
+            break;
+    }
+    fclose(file);
+    return rss;
+}
+
+bool hibernate_enter(void)
+{
+    char path[64];
+    char temp[64];
+    long before = hibernate_rss(getpid());
+    long after;
+    FILE *file;
+
+    if (java_hibernate() != true)
+        return false;
+    allocator_trim();
+    after = hibernate_rss(getpid());
+    log_debug("Service hibernated, resident memory %ld kB -> %ld kB", before, after);
+
+    /* Renamed over, the hibernate command never reads half a line */
+    snprintf(path, sizeof(path), "/tmp/%d.deimos_hibernated", (int)getpid());
+    snprintf(temp, sizeof(temp), "/tmp/%d.deimos_hibernated.tmp", (int)getpid());
+    file = fopen(temp, "w");
+    if (file != NULL) {
+        fprintf(file, "%ld %ld\n", before, after);
+        if (fclose(file) != 0 || rename(temp, path) != 0)
+            unlink(temp);
+    }
+    return true;
+}
+
+/* Fault the writable private anonymous mappings (the committed heap and the
+ * native arenas) back in */
+static void retouch(void)
+{
+    char line[512];
+    char perms[8];
+    unsigned long start, end, total = 0;
+    int path;
+    FILE *file = fopen("/proc/self/maps", "r");
+
+    if (file == NULL)
+        return;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        path = 0;
+        if (sscanf(line, "%lx-%lx %7s %*s %*s %*s %n", &start, &end, perms, &path) < 3)
+            continue;
+        /* Anonymous, or the brk heap */
+        if (strcmp(perms, "rw-p") != 0 ||
+            (path > 0 && line[path] != '\0' && strncmp(line + path, "[heap]", 6) != 0))
+            continue;
+        if (madvise((void *)start, end - start, MADV_POPULATE_WRITE) != 0) {
+            if (errno == EINVAL) {
+                log_debug("MADV_POPULATE_WRITE not supported, memory not touched");
+                break;
+            }
+            continue;
+        }
+        total += end - start;
+    }
+    fclose(file);
+    log_debug("Touched %lu kB of memory again", total / 1024);
+}
+
+void hibernate_leave(arg_data *args)
+{
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/%d.deimos_hibernated", (int)getpid());
+    unlink(path);
+    if (args->retouch == true)
+        retouch();
+}
+
+bool hibernate_report(pid_t pid)
+{
+    static pid_t reported = 0;
+    char path[64];
+    long before, after;
+    FILE *file;
+
+    snprintf(path, sizeof(path), "/tmp/%d.deimos_hibernated", (int)pid);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        if (reported == 0)
+            return false;
+        reported = 0;
+        status_set("hibernated", "no");
+        return true;
+    }
+    if (reported == pid || fscanf(file, "%ld %ld", &before, &after) != 2) {
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+    reported = pid;
+    status_set("hibernated", "yes");
+    status_set("hibernate_rss_before_kb", "%ld", before);
+    status_set("hibernate_rss_after_kb", "%ld", after);
+    return true;
+}
@@ -90,6 +90,7 @@ static bool parse(home_data *data)
             log_debug("Checking library %s", libf);
             if (libf == NULL || !checkfile(libf)) {
                 log_debug("Cannot locate library for VM %s (skipping)", libf);
+                free(libf);
             }
             else {
                 data->jvms[data->jnum] = (home_jvm *)malloc(sizeof(home_jvm));
@@ -100,6 +101,7 @@ static bool parse(home_data *data)
             }
         }
     }
+    fclose(cfgf);
     return true;
 }
 
@@ -0,0 +1,238 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+
+#ifndef PR_SET_THP_DISABLE
+#define PR_SET_THP_DISABLE 41
+#endif
+
+#define THP_ENABLED "/sys/kernel/mm/transparent_hugepage/enabled"
+
+/* Read the value of a /proc/meminfo line, 0 if not found */
+static unsigned long long meminfo(const char *key)
+{
+    FILE *file = fopen("/proc/meminfo", "r");
+    char line[256];
+    size_t len = strlen(key);
+    unsigned long long value = 0;
+
+    if (file == NULL)
+        return 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, key, len) == 0 && line[len] == ':') {
+            value = strtoull(line + len + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+/* Read a number from a sysfs file */
+static bool read_number(const char *path, unsigned long long *value)
+{
+    FILE *file = fopen(path, "r");
+    bool result;
+
+    if (file == NULL)
+        return false;
+    result = fscanf(file, "%llu", value) == 1;
+    fclose(file);
+    return result;
+}
+
+/* The system wide THP mode, the bracketed one of "always [madvise] never" */
+static bool thp_mode(char *mode, int len)
+{
+    FILE *file = fopen(THP_ENABLED, "r");
+    char buf[128];
+    char *start, *end;
+
+    if (file == NULL)
+        return false;
+    if (fgets(buf, sizeof(buf), file) == NULL) {
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+    start = strchr(buf, '[');
+    end = start == NULL ? NULL : strchr(start, ']');
+    if (end == NULL)
+        return false;
+    *end = '\0';
+    snprintf(mode, len, "%s", start + 1);
+    return true;
+}
+
+bool hugepages_memlock(arg_data *args)
+{
+    struct rlimit limit;
+    rlim_t value = RLIM_INFINITY;
+
+    if (args->memlock == NULL && args->mlockall != true)
+        return true;
+    /* mlockall() locks all the reserved address space of the JVM */
+    if (args->memlock != NULL && strcmp(args->memlock, "unlimited") != 0)
+        value = (rlim_t)parse_size(args->memlock);
+
+    limit.rlim_cur = value;
+    limit.rlim_max = value;
+    if (setrlimit(RLIMIT_MEMLOCK, &limit) != 0) {
+        /* Unprivileged: the soft limit can still go up to the hard one */
+        if (getrlimit(RLIMIT_MEMLOCK, &limit) != 0 ||
+            (limit.rlim_max != RLIM_INFINITY &&
+             (value == RLIM_INFINITY || value > limit.rlim_max))) {
+            log_error("Cannot raise RLIMIT_MEMLOCK to %s: the hard limit is "
+                      "%llu kB and raising it needs CAP_SYS_RESOURCE",
+                      args->memlock == NULL ? "unlimited" : args->memlock,
+                      (unsigned long long)limit.rlim_max / 1024);
+            return false;
+        }
+        limit.rlim_cur = value;
+        if (setrlimit(RLIMIT_MEMLOCK, &limit) != 0) {
+            log_error("Cannot raise RLIMIT_MEMLOCK: %s", strerror(errno));
+            return false;
+        }
+    }
+    log_debug("RLIMIT_MEMLOCK set to %s",
+              args->memlock == NULL ? "unlimited" : args->memlock);
+    return true;
+}
+
+/* Whether a boolean JVM flag is on: the last -XX:+<flag> or -XX:-<flag>
+ * wins, as in the JVM */
+static bool jvm_flag(arg_data *args, const char *flag)
+{
+    int x;
+
+    for (x = args->onum - 1; x >= 0; x--) {
+        if (strncmp(args->opts[x], "-XX:", 4) != 0 ||
+            (args->opts[x][4] != '+' && args->opts[x][4] != '-') ||
+            strcmp(args->opts[x] + 5, flag) != 0)
+            continue;
+        return args->opts[x][4] == '+';
+    }
+    return false;
+}
+
+/* Check that the huge page pool can hold the heap of -XX:+UseLargePages */
+static bool check_largepages(arg_data *args)
+{
+    char path[256];
+    char *option;
+    unsigned long long heap, pagesize, needed;
+    unsigned long long total = 0, free = 0, reserved = 0;
+
+    option = find_option(args, "-Xmx");
+    if (option != NULL)
+        heap = parse_size(option + 4);
+    else if ((option = find_option(args, "-XX:MaxHeapSize=")) != NULL)
+        heap = parse_size(option + 16);
+    else {
+        log_debug("No maximum heap size, huge pages not checked");
+        return true;
+    }
+
+    option = find_option(args, "-XX:LargePageSizeInBytes=");
+    pagesize = option == NULL ? 0 : parse_size(option + 25);
+    if (pagesize == 0 || pagesize == meminfo("Hugepagesize") * 1024) {
+        pagesize = meminfo("Hugepagesize") * 1024;
+        total    = meminfo("HugePages_Total");
+        free     = meminfo("HugePages_Free");
+        reserved = meminfo("HugePages_Rsvd");
+    }
+    else {
+        snprintf(path, sizeof(path), "/sys/kernel/mm/hugepages/hugepages-%llukB/",
+                 pagesize / 1024);
+        strcat(path, "nr_hugepages");
+        if (!read_number(path, &total)) {
+            log_error("No huge pages of %llu kB on this system", pagesize / 1024);
+            return false;
+        }
+        strcpy(strrchr(path, '/') + 1, "free_hugepages");
+        read_number(path, &free);
+        strcpy(strrchr(path, '/') + 1, "resv_hugepages");
+        read_number(path, &reserved);
+    }
+    if (pagesize == 0) {
+        log_error("-XX:+UseLargePages is set but huge pages are not supported");
+        return false;
+    }
+
+    needed = (heap + pagesize - 1) / pagesize;
+    log_debug("Heap needs %llu huge pages of %llu kB, %llu free and %llu "
+              "reserved out of %llu", needed, pagesize / 1024, free, reserved,
+              total);
+    if (free < reserved || needed > free - reserved) {
+        log_error("-XX:+UseLargePages needs %llu huge pages of %llu kB for the "
+                  "heap but only %llu are available (see /proc/sys/vm/nr_hugepages)",
+                  needed, pagesize / 1024, free < reserved ? 0 : free - reserved);
+        return false;
+    }
+    return true;
+}
+
+bool hugepages_apply(arg_data *args)
+{
+    char mode[32] = "";
+
+    if (args->thp != NULL) {
+        thp_mode(mode, sizeof(mode));
+        if (strcmp(args->thp, "never") == 0) {
+            if (prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0) != 0) {
+                log_error("Cannot disable transparent huge pages: %s",
+                          strerror(errno));
+                return false;
+            }
+        }
+        else if (strcmp(mode, "never") == 0 || mode[0] == '\0') {
+            log_error("-thp %s: transparent huge pages are %s on this system",
+                      args->thp, mode[0] ? "disabled" : "not available");
+            return false;
+        }
+        else if (strcmp(args->thp, "always") == 0 && strcmp(mode, "always") != 0) {
+            log_error("-thp always: transparent huge pages are only used on "
+                      "request (%s), use -thp madvise", THP_ENABLED);
+            return false;
+        }
+        else if (find_option(args, "-XX:+UseTransparentHugePages") == NULL &&
+                 find_option(args, "-XX:-UseTransparentHugePages") == NULL) {
+            /* The JVM madvise()s its heap */
+            if (add_option(args, "-XX:+UseTransparentHugePages") != true)
+                return false;
+        }
+        log_debug("Transparent huge pages: %s (system: %s)", args->thp, mode);
+    }
+
+    if (jvm_flag(args, "UseLargePages") == true &&
+        jvm_flag(args, "UseTransparentHugePages") == false &&
+        check_largepages(args) != true)
+        return false;
+
+    if (args->mlockall == true) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+            log_error("Cannot lock the memory of the JVM: %s", strerror(errno));
+            return false;
+        }
+        log_debug("Memory of the JVM locked");
+    }
+    return true;
+}
@@ -17,6 +17,8 @@
 #include "deimos.h"
 #include "embedded.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <jni.h>
 
@@ -394,6 +396,134 @@ bool JVM_destroy(int exit)
     return true;
 }
 
+/* Wrap an inherited listening socket in a ServerSocketChannel. JNI ignores
+ * the access checks, which lets us use the JDK private constructors */
+static jobject java_channel(int fd, jobject provider)
+{
+    jclass clazz;
+    jmethodID method;
+    jfieldID field;
+    jobject descriptor;
+    jobject family;
+
+    clazz = (*env)->FindClass(env, "java/io/FileDescriptor");
+    method = (*env)->GetMethodID(env, clazz, "<init>", "()V");
+    field = (*env)->GetFieldID(env, clazz, "fd", "I");
+    if (method == NULL || field == NULL)
+        return NULL;
+    descriptor = (*env)->NewObject(env, clazz, method);
+    (*env)->SetIntField(env, descriptor, field, fd);
+
+    clazz = (*env)->FindClass(env, "sun/nio/ch/ServerSocketChannelImpl");
+    if (clazz == NULL)
+        return NULL;
+    /* Java 6 to 15 */
+    method = (*env)->GetMethodID(env, clazz, "<init>",
+                                 "(Ljava/nio/channels/spi/SelectorProvider;"
+                                 "Ljava/io/FileDescriptor;Z)V");
+    if (method != NULL)
+        return (*env)->NewObject(env, clazz, method, provider, descriptor, TRUE);
+    (*env)->ExceptionClear(env);
+
+    /* Java 16 and later also want the protocol family */
+    method = (*env)->GetMethodID(env, clazz, "<init>",
+                                 "(Ljava/nio/channels/spi/SelectorProvider;"
+                                 "Ljava/net/ProtocolFamily;"
+                                 "Ljava/io/FileDescriptor;Z)V");
+    if (method == NULL)
+        return NULL;
+    clazz = (*env)->FindClass(env, "java/net/StandardProtocolFamily");
+    field = (*env)->GetStaticFieldID(env, clazz, listen_inet6(fd) ? "INET6" : "INET",
+                                     "Ljava/net/StandardProtocolFamily;");
+    if (field == NULL)
+        return NULL;
+    family = (*env)->GetStaticObjectField(env, clazz, field);
+    clazz = (*env)->FindClass(env, "sun/nio/ch/ServerSocketChannelImpl");
+    return (*env)->NewObject(env, clazz, method, provider, family, descriptor, TRUE);
+}
+
+/* Hand the sockets inherited from the controller (LISTEN_FDS) to our
+ * wrapper class. The channels wrap duplicates, so a service closing its
+ * channel leaves the inherited socket to the next reload */
+bool java_listeners(void)
+{
+    const char *pid = getenv("LISTEN_PID");
+    const char *fds = getenv("LISTEN_FDS");
+    const char *fdnames = getenv("LISTEN_FDNAMES");
+    char *names = NULL;
+    char *name;
+    char *save = NULL;
+    jclass clazz;
+    jmethodID method;
+    jobject provider;
+    jobject channel;
+    jobjectArray nameArray;
+    jobjectArray channelArray;
+    int count, x, fd;
+
+    if (pid == NULL || fds == NULL || atoi(pid) != (int)getpid())
+        return true;
+    count = atoi(fds);
+    if (count <= 0)
+        return true;
+
+    clazz = (*env)->FindClass(env, "java/nio/channels/spi/SelectorProvider");
+    method = (*env)->GetStaticMethodID(env, clazz, "provider",
+                                       "()Ljava/nio/channels/spi/SelectorProvider;");
+    if (method == NULL) {
+        log_error("Cannot find \"SelectorProvider.provider()\" entry point");
+        return false;
+    }
+    provider = (*env)->CallStaticObjectMethod(env, clazz, method);
+
+    nameArray = (*env)->NewObjectArray(env, count,
+                                       (*env)->FindClass(env, "java/lang/String"), NULL);
+    channelArray = (*env)->NewObjectArray(env, count,
+                                          (*env)->FindClass(env, "java/nio/channels/ServerSocketChannel"),
+                                          NULL);
+    if (provider == NULL || nameArray == NULL || channelArray == NULL) {
+        log_error("Cannot create listening channel arrays");
+        return false;
+    }
+
+    if (fdnames != NULL)
+        names = strdup(fdnames);
+    name = names == NULL ? NULL : strtok_r(names, ":", &save);
+    for (x = 0; x < count; x++) {
+        fd = fcntl(3 + x, F_DUPFD_CLOEXEC, 0);
+        if (fd < 0) {
+            log_error("Cannot duplicate the listening socket %d: %s", 3 + x, strerror(errno));
+            free(names);
+            return false;
+        }
+        channel = java_channel(fd, provider);
+        if (channel == NULL || (*env)->ExceptionCheck(env)) {
+            (*env)->ExceptionDescribe(env);
+            (*env)->ExceptionClear(env);
+            log_error("Cannot create a channel for the listening socket %d", 3 + x);
+            close(fd);
+            free(names);
+            return false;
+        }
+        (*env)->SetObjectArrayElement(env, channelArray, x, channel);
+        (*env)->SetObjectArrayElement(env, nameArray, x,
+                                      (*env)->NewStringUTF(env, name != NULL ? name : "unknown"));
+        if (name != NULL)
+            name = strtok_r(NULL, ":", &save);
+    }
+    free(names);
+
+    method = (*env)->GetMethodID(env, (*env)->GetObjectClass(env, loader), "listen",
+                                 "([Ljava/lang/String;[Ljava/nio/channels/ServerSocketChannel;)V");
+    if (method == NULL) {
+        log_error("Cannot find Daemon Loader \"listen\" entry point");
+        return false;
+    }
+    (*env)->CallVoidMethod(env, loader, method, nameArray, channelArray);
+    log_debug("%d listening sockets handed to the daemon", count);
+    return true;
+}
+
 /* Call the load method in our wrapper class */
 bool java_load(arg_data *args)
 {
@@ -498,6 +628,35 @@ bool java_stop(void)
     return true;
 }
 
+/* Call the reload method in our daemon loader */
+bool java_reload(void)
+{
+    bool result;
+
+    /* Fresh channels for the new service, the old ones are closed with it */
+    if (java_listeners() != true)
+        return false;
+    result = java_call("reload");
+    if (result == FALSE) {
+        log_error("Cannot reload daemon in the Java VM");
+        return false;
+    }
+    log_debug("Daemon reloaded successfully");
+    return true;
+}
+
+/* Call the hibernate method in our daemon loader */
+bool java_hibernate(void)
+{
+    bool result = java_call("hibernate");
+    if (result == FALSE) {
+        log_error("Cannot hibernate daemon");
+        return false;
+    }
+    log_debug("Daemon hibernated successfully");
+    return true;
+}
+
 /* Call the destroy method in our daemon loader */
 bool java_destroy()
 {
@@ -0,0 +1,135 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+/* From linux/prctl.h, Linux 6.4 */
+#ifndef PR_SET_MEMORY_MERGE
+#define PR_SET_MEMORY_MERGE 67
+#define PR_GET_MEMORY_MERGE 68
+#endif
+
+/* Seconds between two reads of ksm_stat */
+#define KSM_REPORT 10
+
+static bool merge_supported(void)
+{
+    return prctl(PR_GET_MEMORY_MERGE, 0, 0, 0, 0) >= 0 || errno != EINVAL;
+}
+
+bool ksm_environ(arg_data *args)
+{
+    char path[PATH_MAX];
+    const char *shim = args->ksmshim;
+    char *slash;
+    ssize_t len;
+
+    if (args->ksm != true || merge_supported())
+        return true;
+
+    /* The shim is installed next to deimos by default */
+    if (shim == NULL) {
+        len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+        if (len <= 0) {
+            log_error("Cannot find the KSM shim, use -ksmshim");
+            return false;
+        }
+        path[len] = '\0';
+        slash = strrchr(path, '/');
+        snprintf(slash + 1, sizeof(path) - (slash + 1 - path), "libksm.so");
+        shim = path;
+    }
+    if (access(shim, R_OK) != 0) {
+        log_error("Cannot read KSM shim %s", shim);
+        return false;
+    }
+    allocator_preload(shim);
+    return true;
+}
+
+bool ksm_apply(arg_data *args)
+{
+    char run[8];
+    FILE *file;
+
+    if (args->ksm != true)
+        return true;
+
+    /* Merging only happens when the daemon runs, but that is up to the host */
+    file = fopen("/sys/kernel/mm/ksm/run", "r");
+    if (file == NULL || fgets(run, sizeof(run), file) == NULL || run[0] != '1')
+        log_error("KSM is not running on this host, no page will be merged");
+    if (file != NULL)
+        fclose(file);
+
+    if (prctl(PR_SET_MEMORY_MERGE, 1, 0, 0, 0) == 0) {
+        log_debug("KSM enabled for the whole process");
+        return true;
+    }
+    if (errno == EINVAL) {
+        log_debug("KSM enabled for the anonymous mappings by the preloaded shim");
+        return true;
+    }
+    log_error("Cannot enable KSM: %s", strerror(errno));
+    return false;
+}
+
+bool ksm_report(arg_data *args, pid_t pid)
+{
+    static time_t last = 0;
+    static long long merging = -1;
+    long long value, profit = 0, pages = -1;
+    bool any = false;
+    char path[64];
+    char line[128];
+    char key[64];
+    FILE *file;
+
+    if (args->ksm != true || time(NULL) - last < KSM_REPORT)
+        return false;
+    last = time(NULL);
+
+    snprintf(path, sizeof(path), "/proc/%d/ksm_stat", (int)pid);
+    file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, "ksm_merge_any: yes", 18) == 0)
+            any = true;
+        if (sscanf(line, "%63[^ ] %lld", key, &value) != 2)
+            continue;
+        if (strcmp(key, "ksm_merging_pages") == 0)
+            pages = value;
+        else if (strcmp(key, "ksm_process_profit") == 0)
+            profit = value;
+    }
+    fclose(file);
+    if (pages < 0 || pages == merging)
+        return false;
+
+    merging = pages;
+    status_set("ksm", "%s", any ? "process" : "mappings");
+    status_set("ksm_merging_pages", "%lld", pages);
+    status_set("ksm_profit_kb", "%lld", profit / 1024);
+    log_debug("KSM merges %lld pages of process %d, saving %lld kB", pages,
+              (int)pid, profit / 1024);
+    return true;
+}
@@ -0,0 +1,204 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+/* From fcntl.h with _GNU_SOURCE, Linux 3.15 */
+#ifndef F_OFD_SETLK
+#define F_OFD_SETLK 37
+#endif
+
+#define LEASE_OWNER 128
+
+static int lease_fd = -1;
+static char lease_me[LEASE_OWNER];
+static bool lease_held = false;
+static long long lease_renewed = 0;     /* monotonic time of the renewal */
+
+static long long lease_clock(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* "<host>:<pid>" of a process of this host */
+static void lease_owner(pid_t pid, char *owner, int len)
+{
+    char host[64];
+
+    if (gethostname(host, sizeof(host)) != 0)
+        strcpy(host, "localhost");
+    host[sizeof(host) - 1] = '\0';
+    snprintf(owner, len, "%s:%d", host, (int)pid);
+}
+
+/* Open file description locks: released with the last descriptor of the
+ * file, not with any close() of the process */
+static bool lease_lock(int fd, short type)
+{
+    struct flock lock;
+
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    return fcntl(fd, F_OFD_SETLK, &lock) == 0;
+}
+
+/* "<owner> <heartbeat>", "-" and 0 when given up */
+static void lease_read(int fd, char *owner, long long *heartbeat)
+{
+    char buf[LEASE_OWNER + 32];
+    ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+
+    owner[0] = '\0';
+    *heartbeat = 0;
+    if (len <= 0)
+        return;
+    buf[len] = '\0';
+    if (sscanf(buf, "%127s %lld", owner, heartbeat) != 2 || strcmp(owner, "-") == 0)
+        owner[0] = '\0';
+}
+
+static bool lease_write(const char *owner, long long heartbeat)
+{
+    char buf[LEASE_OWNER + 32];
+    int len = snprintf(buf, sizeof(buf), "%s %lld\n", owner, heartbeat);
+
+    if (pwrite(lease_fd, buf, len, 0) != len || ftruncate(lease_fd, len) != 0)
+        return false;
+    /* Other hosts read it from the shared file system */
+    return fdatasync(lease_fd) == 0;
+}
+
+/* The owner is a process of this host that exited, or a zombie nobody
+   reaped yet (its controller was killed along with it) */
+static bool lease_dead(const char *owner)
+{
+    char host[LEASE_OWNER];
+    char line[256];
+    const char *colon = strrchr(owner, ':');
+    bool dead = false;
+    size_t len;
+    FILE *file;
+
+    /* "<host>:0", the host name is compared with its colon */
+    lease_owner(0, host, sizeof(host));
+    len = strlen(host) - 1;
+    if (colon == NULL || (size_t)(colon - owner + 1) != len ||
+        strncmp(owner, host, len) != 0)
+        return false;
+    if (kill(atoi(colon + 1), 0) != 0)
+        return errno == ESRCH;
+    /* State 'Z', after the command in parentheses */
+    snprintf(line, sizeof(line), "/proc/%d/stat", atoi(colon + 1));
+    file = fopen(line, "r");
+    if (file == NULL)
+        return false;
+    if (fgets(line, sizeof(line), file) != NULL && strrchr(line, ')') != NULL)
+        dead = strncmp(strrchr(line, ')'), ") Z", 3) == 0;
+    fclose(file);
+    return dead;
+}
+
+bool lease_open(arg_data *args)
+{
+    lease_fd = open(args->lease, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lease_fd < 0) {
+        log_error("Cannot open lease file \"%s\": %s", args->lease, strerror(errno));
+        return false;
+    }
+    lease_owner(getpid(), lease_me, sizeof(lease_me));
+    return true;
+}
+
+bool lease_hold(arg_data *args)
+{
+    long long now = lease_clock(CLOCK_REALTIME);
+    long long lapse = args->leasetime * 1000LL;
+    long long heartbeat;
+    char owner[LEASE_OWNER];
+    int held = -1;              /* unknown when the file could not be read */
+
+    if (lease_lock(lease_fd, F_WRLCK) == true) {
+        lease_read(lease_fd, owner, &heartbeat);
+        if (strcmp(owner, lease_me) == 0 || owner[0] == '\0' ||
+            now - heartbeat >= lapse || lease_dead(owner)) {
+            if (lease_held == false)
+                log_debug("Taking the lease over from \"%s\"", owner);
+            held = lease_write(lease_me, now) ? 1 : -1;
+        }
+        else
+            held = 0;
+        lease_lock(lease_fd, F_UNLCK);
+    }
+    if (held == 1)
+        lease_renewed = lease_clock(CLOCK_MONOTONIC);
+    /* Keep going on a failed renewal only for half a lapse: a standby
+       cannot take over before the full lapse, and the margin covers the
+       check period and some clock skew between the hosts */
+    else if (held == -1 && lease_held == true &&
+             lease_clock(CLOCK_MONOTONIC) - lease_renewed < lapse / 2)
+        held = 1;
+    if (held != 1 && lease_held == true)
+        log_error("Lease of \"%s\" lost", args->lease);
+    lease_held = held == 1;
+    return lease_held;
+}
+
+void lease_release(void)
+{
+    char owner[LEASE_OWNER];
+    long long heartbeat;
+
+    if (lease_held == false || lease_lock(lease_fd, F_WRLCK) != true)
+        return;
+    lease_read(lease_fd, owner, &heartbeat);
+    if (strcmp(owner, lease_me) == 0)
+        lease_write("-", 0);
+    lease_lock(lease_fd, F_UNLCK);
+    lease_held = false;
+}
+
+bool lease_report(arg_data *args, pid_t pid)
+{
+    static char last[LEASE_OWNER] = "";
+    char me[LEASE_OWNER];
+    char owner[LEASE_OWNER];
+    long long heartbeat;
+    int fd;
+
+    if (args->lease == NULL)
+        return false;
+    fd = open(args->lease, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    lease_read(fd, owner, &heartbeat);
+    close(fd);
+    if (strcmp(owner, last) == 0)
+        return false;
+    strcpy(last, owner);
+    lease_owner(pid, me, sizeof(me));
+    status_set("lease", strcmp(owner, me) == 0 ? "active" : "standby");
+    status_set("lease_owner", "%s", owner[0] != '\0' ? owner : "-");
+    return true;
+}
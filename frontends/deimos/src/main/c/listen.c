@@ -0,0 +1,235 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* First descriptor of the LISTEN_FDS convention */
+#define LISTEN_FDS_START 3
+
+static int *sockets = NULL;
+
+/* Name of a listener: what comes before '=', or the address itself */
+static const char *listener_name(const char *listener, char *buf, size_t len)
+{
+    const char *eq = strchr(listener, '=');
+
+    if (eq == NULL)
+        return listener;
+    snprintf(buf, len, "%.*s", (int)(eq - listener), listener);
+    return buf;
+}
+
+/* Bind a listening socket on [<host>]:<port>, [<ipv6>]:<port> or <port> */
+static int bind_listener(const char *address)
+{
+    struct addrinfo hints, *result, *ai;
+    char host[256];
+    const char *port = strrchr(address, ':');
+    const char *node = NULL;
+    int fd = -1, one = 1, ret;
+
+    if (port == NULL)
+        port = address;
+    else {
+        snprintf(host, sizeof(host), "%.*s", (int)(port - address), address);
+        port++;
+        if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+            memmove(host, host + 1, strlen(host) - 2);
+            host[strlen(host) - 2] = '\0';
+        }
+        if (host[0] != '\0' && strcmp(host, "*") != 0)
+            node = host;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    ret = getaddrinfo(node, port, &hints, &result);
+    if (ret != 0) {
+        log_error("Cannot resolve listen address %s: %s", address, gai_strerror(ret));
+        return -1;
+    }
+    /* The wildcard IPv6 address also accepts IPv4 connections */
+    for (ai = result; ai != NULL && fd < 0; ai = ai->ai_next) {
+        if (node == NULL && ai->ai_family != AF_INET6 && ai->ai_next != NULL)
+            continue;
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, SOMAXCONN) != 0) {
+            ret = errno;
+            close(fd);
+            fd = -1;
+            errno = ret;
+        }
+    }
+    freeaddrinfo(result);
+    if (fd < 0)
+        log_error("Cannot listen on %s: %s", address, strerror(errno));
+    return fd;
+}
+
+bool listen_open(arg_data *args)
+{
+    char buf[256];
+    const char *eq;
+    size_t len = 0;
+    int x;
+
+    if (args->lnum == 0 && args->lazy == true) {
+        log_error("-lazy needs a -listen address to wait on");
+        return false;
+    }
+    /* Opened once for all the -replicas */
+    if (args->lnum == 0 || sockets != NULL)
+        return true;
+    sockets = (int *)malloc(args->lnum * sizeof(int));
+    buf[0] = '\0';
+    for (x = 0; x < args->lnum; x++) {
+        eq = strchr(args->listen[x], '=');
+        sockets[x] = bind_listener(eq == NULL ? args->listen[x] : eq + 1);
+        if (sockets[x] < 0)
+            return false;
+        log_debug("Listening on %s", args->listen[x]);
+        len = strlen(buf);
+        snprintf(buf + len, sizeof(buf) - len, "%s%s", len ? "," : "",
+                 args->listen[x]);
+    }
+    status_set("listen", "%s", buf);
+    return true;
+}
+
+bool listen_child(arg_data *args)
+{
+    char names[1024];
+    char name[256];
+    char value[32];
+    size_t len;
+    int high, fd, x;
+
+    if (args->lnum == 0)
+        return true;
+
+    /* Out of the way first, a socket may already sit where another goes */
+    high = LISTEN_FDS_START + args->lnum;
+    for (x = 0; x < args->lnum; x++) {
+        fd = fcntl(sockets[x], F_DUPFD_CLOEXEC, high);
+        if (fd < 0) {
+            log_error("Cannot duplicate listening socket: %s", strerror(errno));
+            return false;
+        }
+        close(sockets[x]);
+        sockets[x] = fd;
+    }
+    names[0] = '\0';
+    for (x = 0; x < args->lnum; x++) {
+        /* dup2() clears FD_CLOEXEC: the programs started by the JVM do not
+         * get the sockets */
+        if (dup2(sockets[x], LISTEN_FDS_START + x) < 0 ||
+            fcntl(LISTEN_FDS_START + x, F_SETFD, FD_CLOEXEC) != 0) {
+            log_error("Cannot hand listening socket over: %s", strerror(errno));
+            return false;
+        }
+        close(sockets[x]);
+        len = strlen(names);
+        snprintf(names + len, sizeof(names) - len, "%s%s", x ? ":" : "",
+                 listener_name(args->listen[x], name, sizeof(name)));
+    }
+    snprintf(value, sizeof(value), "%d", (int)getpid());
+    setenv("LISTEN_PID", value, 1);
+    snprintf(value, sizeof(value), "%d", args->lnum);
+    setenv("LISTEN_FDS", value, 1);
+    setenv("LISTEN_FDNAMES", names, 1);
+    return true;
+}
+
+bool listen_wait(arg_data *args, int ms)
+{
+    struct pollfd fds[args->lnum];
+    int x;
+
+    for (x = 0; x < args->lnum; x++) {
+        fds[x].fd = sockets[x];
+        fds[x].events = POLLIN;
+    }
+    return poll(fds, args->lnum, ms) > 0;
+}
+
+/* Count the established connections to some ports in /proc/net/tcp[6] */
+static int established(const char *path, const int *ports, int count)
+{
+    char line[256];
+    unsigned int port, state;
+    int connections = 0;
+    int x;
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+        return 0;
+    /* "  sl  local_address rem_address   st ..." */
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, " %*d: %*[0-9A-Fa-f]:%x %*[0-9A-Fa-f]:%*x %x",
+                   &port, &state) != 2 || state != 0x01)
+            continue;
+        for (x = 0; x < count; x++) {
+            if (ports[x] == (int)port)
+                connections++;
+        }
+    }
+    fclose(file);
+    return connections;
+}
+
+int listen_connections(arg_data *args)
+{
+    struct sockaddr_storage address;
+    socklen_t len;
+    int ports[args->lnum];
+    int x;
+
+    for (x = 0; x < args->lnum; x++) {
+        len = sizeof(address);
+        ports[x] = -1;
+        if (getsockname(sockets[x], (struct sockaddr *)&address, &len) != 0)
+            continue;
+        if (address.ss_family == AF_INET6)
+            ports[x] = ntohs(((struct sockaddr_in6 *)&address)->sin6_port);
+        else
+            ports[x] = ntohs(((struct sockaddr_in *)&address)->sin_port);
+    }
+    return established("/proc/net/tcp", ports, args->lnum) +
+           established("/proc/net/tcp6", ports, args->lnum) +
+           (listen_wait(args, 0) ? 1 : 0);
+}
+
+bool listen_inet6(int fd)
+{
+    struct sockaddr_storage address;
+    socklen_t len = sizeof(address);
+
+    if (getsockname(fd, (struct sockaddr *)&address, &len) != 0)
+        return false;
+    return address.ss_family == AF_INET6;
+}
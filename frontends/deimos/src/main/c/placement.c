@@ -0,0 +1,543 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include "deimos.h"
+#include <sched.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/syscall.h>
+
+/* Memory policies, from linux/mempolicy.h */
+#define MPOL_BIND       2
+#define MPOL_INTERLEAVE 3
+
+#define NODE_BITS 1024
+#define LONG_BITS (8 * sizeof(unsigned long))
+#define MASK_LONGS(bits) (((bits) + LONG_BITS - 1) / LONG_BITS)
+
+/* Parse a list like "0-3,8" into a bit mask */
+static bool parse_list(const char *list, unsigned long *mask, int bits)
+{
+    const char *ptr = list;
+    char *end;
+    long first, last;
+
+    memset(mask, 0, MASK_LONGS(bits) * sizeof(unsigned long));
+    while (true) {
+        first = strtol(ptr, &end, 10);
+        if (end == ptr || first < 0)
+            return false;
+        last = first;
+        if (*end == '-') {
+            ptr = end + 1;
+            last = strtol(ptr, &end, 10);
+            if (end == ptr || last < first)
+                return false;
+        }
+        if (last >= bits)
+            return false;
+        for (; first <= last; first++)
+            mask[first / LONG_BITS] |= 1UL << (first % LONG_BITS);
+        if (*end == '\0' || *end == '\n')
+            return true;
+        if (*end != ',')
+            return false;
+        ptr = end + 1;
+    }
+}
+
+static bool is_set(const unsigned long *mask, int bit)
+{
+    return (mask[bit / LONG_BITS] & (1UL << (bit % LONG_BITS))) != 0;
+}
+
+/* Read the first line of a file */
+static bool read_file(const char *path, char *buf, int len)
+{
+    FILE *file = fopen(path, "r");
+    bool result;
+
+    if (file == NULL)
+        return false;
+    result = fgets(buf, len, file) != NULL;
+    fclose(file);
+    if (result)
+        buf[strcspn(buf, "\r\n")] = '\0';
+    return result;
+}
+
+/* Read a "Key:\tvalue" line of /proc/<pid>/status */
+static bool read_proc_status(pid_t pid, const char *key, char *buf, int len)
+{
+    char path[64];
+    char line[1024];
+    size_t klen = strlen(key);
+    bool found = false;
+    FILE *file;
+
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    while (found == false && fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, key, klen) == 0 && line[klen] == ':') {
+            snprintf(buf, len, "%s", line + klen + 1 + strspn(line + klen + 1, " \t"));
+            buf[strcspn(buf, "\r\n")] = '\0';
+            found = true;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+/* Memory policy and nodes of a -numa specification */
+static bool numa_nodes(const char *spec, int *mode, unsigned long *nodes)
+{
+    char online[1024];
+
+    *mode = MPOL_BIND;
+    if (strncmp(spec, "interleave", 10) == 0) {
+        *mode = MPOL_INTERLEAVE;
+        if (spec[10] == ':')
+            spec += 11;
+        else if (spec[10] == '\0' &&
+                 read_file("/sys/devices/system/node/online", online, sizeof(online)))
+            spec = online;
+        else if (spec[10] == '\0')
+            spec = "0";
+        else
+            return false;
+    }
+    return parse_list(spec, nodes, NODE_BITS);
+}
+
+/* Fill a CPU set from a list like "0-3,8" */
+static bool cpu_set(const char *cpulist, cpu_set_t *set)
+{
+    unsigned long cpus[MASK_LONGS(CPU_SETSIZE)];
+    int x;
+
+    if (parse_list(cpulist, cpus, CPU_SETSIZE) != true) {
+        log_error("Invalid CPU list %s", cpulist);
+        return false;
+    }
+    CPU_ZERO(set);
+    for (x = 0; x < CPU_SETSIZE; x++) {
+        if (is_set(cpus, x))
+            CPU_SET(x, set);
+    }
+    return true;
+}
+
+/* CPUs of -cpus or of the nodes -numa binds the memory to, in list */
+static bool cpu_list(arg_data *args, char *list, int len)
+{
+    unsigned long nodes[MASK_LONGS(NODE_BITS)];
+    char buf[1024];
+    char path[PATH_MAX];
+    int mode, x;
+
+    list[0] = '\0';
+    if (args->cpus != NULL) {
+        snprintf(list, len, "%s", args->cpus);
+        return true;
+    }
+    if (args->numa == NULL || numa_nodes(args->numa, &mode, nodes) != true ||
+        mode != MPOL_BIND)
+        return true;
+    for (x = 0; x < NODE_BITS; x++) {
+        if (!is_set(nodes, x))
+            continue;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", x);
+        if (read_file(path, buf, sizeof(buf)) != true || buf[0] == '\0') {
+            log_error("Cannot find the CPUs of NUMA node %d", x);
+            return false;
+        }
+        if (list[0] != '\0')
+            strncat(list, ",", len - strlen(list) - 1);
+        strncat(list, buf, len - strlen(list) - 1);
+    }
+    return true;
+}
+
+bool placement_bind(arg_data *args, pid_t tid)
+{
+    char list[4096];
+    cpu_set_t set;
+
+    if (cpu_list(args, list, sizeof(list)) != true)
+        return false;
+    if (list[0] == '\0') {
+        if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+            log_error("Cannot get the CPU affinity: %s", strerror(errno));
+            return false;
+        }
+    }
+    else if (cpu_set(list, &set) != true)
+        return false;
+    if (sched_setaffinity(tid, sizeof(set), &set) != 0) {
+        log_error("Cannot bind thread %d to its CPUs: %s", (int)tid, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/* Check the CPU lists of the -threadcpus rules and fill their sets */
+typedef struct {
+    char *pattern;              /* thread name pattern, before the = */
+    const char *cpus;           /* CPU list, after it */
+    cpu_set_t set;
+} thread_rule;
+
+/* Split the -threadcpus rules, or only check them when rules is NULL */
+static bool thread_rules(arg_data *args, thread_rule *rules)
+{
+    const char *cpus;
+    cpu_set_t set;
+    int x;
+
+    for (x = 0; x < args->tcnum; x++) {
+        cpus = strrchr(args->threadcpus[x], '=') + 1;
+        if (cpu_set(cpus, rules != NULL ? &rules[x].set : &set) != true)
+            return false;
+        if (rules == NULL)
+            continue;
+        rules[x].cpus = cpus;
+        rules[x].pattern = strndup(args->threadcpus[x], cpus - 1 - args->threadcpus[x]);
+        if (rules[x].pattern == NULL) {
+            log_error("Cannot allocate the thread rules");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool placement_apply(arg_data *args)
+{
+    unsigned long nodes[MASK_LONGS(NODE_BITS)];
+    char list[4096];
+    cpu_set_t set;
+    int mode;
+
+    /* The rules are applied by the controller, fail before the JVM starts */
+    if (args->tcnum > 0 && thread_rules(args, NULL) != true)
+        return false;
+
+    if (args->numa != NULL) {
+        if (numa_nodes(args->numa, &mode, nodes) != true) {
+            log_error("Invalid NUMA nodes %s", args->numa);
+            return false;
+        }
+        if (syscall(SYS_set_mempolicy, mode, nodes, NODE_BITS + 1) != 0) {
+            log_error("Cannot set the NUMA memory policy %s: %s", args->numa,
+                      strerror(errno));
+            return false;
+        }
+        log_debug("NUMA memory policy set to %s", args->numa);
+    }
+
+    /* Run on the CPUs of the nodes the memory is bound to, unless -cpus is
+     * given, or on the wider startup boost CPUs until the service is ready */
+    if (args->boostcpus != NULL)
+        snprintf(list, sizeof(list), "%s", args->boostcpus);
+    else if (cpu_list(args, list, sizeof(list)) != true)
+        return false;
+
+    if (list[0] != '\0') {
+        if (cpu_set(list, &set) != true)
+            return false;
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            log_error("Cannot bind to CPUs %s: %s", list, strerror(errno));
+            return false;
+        }
+        log_debug("CPU affinity set to %s", list);
+    }
+    return true;
+}
+
+bool placement_replica(arg_data *args, int index)
+{
+    static char cpus[4096];
+    static char numa[16];
+    unsigned long nodes[MASK_LONGS(NODE_BITS)];
+    char online[1024];
+    char list[4096];
+    int ids[CPU_SETSIZE];
+    int node[NODE_BITS];
+    int count = 0, nnodes = 0;
+    int share = args->replicas;
+    int slot = index;
+    int first, size, x;
+    size_t len;
+    cpu_set_t set, allowed;
+
+    /* One NUMA node per replica in turn, unless the placement is given */
+    if (args->cpus == NULL && args->numa == NULL &&
+        read_file("/sys/devices/system/node/online", online, sizeof(online)) &&
+        parse_list(online, nodes, NODE_BITS)) {
+        for (x = 0; x < NODE_BITS; x++) {
+            if (is_set(nodes, x))
+                node[nnodes++] = x;
+        }
+        if (nnodes > 1) {
+            snprintf(numa, sizeof(numa), "%d", node[index % nnodes]);
+            args->numa = numa;
+            /* The replicas of this node */
+            share = (args->replicas - 1 - index % nnodes) / nnodes + 1;
+            slot = index / nnodes;
+        }
+    }
+
+    /* The CPUs to split, within those deimos may run on */
+    if (cpu_list(args, list, sizeof(list)) != true)
+        return false;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        log_error("Cannot get the CPU affinity: %s", strerror(errno));
+        return false;
+    }
+    if (list[0] == '\0')
+        set = allowed;
+    else if (cpu_set(list, &set) != true)
+        return false;
+    for (x = 0; x < CPU_SETSIZE; x++) {
+        if (CPU_ISSET(x, &set) && CPU_ISSET(x, &allowed))
+            ids[count++] = x;
+    }
+    if (count == 0) {
+        log_error("No CPU left for replica %d", index);
+        return false;
+    }
+
+    /* Contiguous slices, the first ones a CPU larger, or a CPU each in turn
+     * when there are more replicas than CPUs */
+    if (count >= share) {
+        size = count / share + (slot < count % share ? 1 : 0);
+        first = slot * (count / share) + (slot < count % share ? slot : count % share);
+    }
+    else {
+        size = 1;
+        first = slot % count;
+    }
+    cpus[0] = '\0';
+    for (x = first; x < first + size; x++) {
+        len = strlen(cpus);
+        snprintf(cpus + len, sizeof(cpus) - len, "%s%d", len ? "," : "", ids[x]);
+    }
+    args->cpus = cpus;
+    log_debug("Replica %d on CPUs %s (NUMA nodes \"%s\")", index, cpus,
+              PRINT_NULL(args->numa));
+    return true;
+}
+
+typedef struct {
+    pid_t tid;
+    int rule;
+} pinned_thread;
+
+/* Threads of the current child bound by the previous scan */
+static pid_t owner = 0;
+static pinned_thread *pinned = NULL;
+static int pnum = 0;
+static long violations = 0;
+static thread_rule *rules = NULL;
+
+static int was_pinned(pid_t tid)
+{
+    int x;
+
+    for (x = 0; x < pnum; x++) {
+        if (pinned[x].tid == tid)
+            return pinned[x].rule;
+    }
+    return -1;
+}
+
+bool placement_threads(arg_data *args, pid_t pid)
+{
+    pinned_thread *current = NULL;
+    int cnum = 0, csize = 0, before = pnum, rule, x;
+    long seen = violations;
+    struct dirent *entry;
+    char path[PATH_MAX];
+    char name[32];
+    cpu_set_t set;
+    pid_t tid;
+    DIR *dir;
+
+    if (args->tcnum == 0)
+        return false;
+    if (rules == NULL) {
+        rules = (thread_rule *)calloc(args->tcnum, sizeof(thread_rule));
+        if (rules == NULL || thread_rules(args, rules) != true) {
+            if (rules != NULL) {
+                for (x = 0; x < args->tcnum; x++)
+                    free(rules[x].pattern);
+                free(rules);
+                rules = NULL;
+            }
+            args->tcnum = 0;
+            return false;
+        }
+    }
+    /* A new child, maybe reusing thread ids */
+    if (owner != pid) {
+        owner = pid;
+        pnum = 0;
+        before = -1;
+        violations = 0;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    dir = opendir(path);
+    if (dir == NULL)
+        return false;
+    while ((entry = readdir(dir)) != NULL) {
+        tid = (pid_t)atoi(entry->d_name);
+        if (tid <= 0)
+            continue;
+        snprintf(path, sizeof(path), "/proc/%d/task/%d/comm", (int)pid, (int)tid);
+        if (read_file(path, name, sizeof(name)) != true)
+            continue;
+        for (rule = 0; rule < args->tcnum; rule++) {
+            if (fnmatch(rules[rule].pattern, name, 0) == 0)
+                break;
+        }
+        if (rule == args->tcnum)
+            continue;
+
+        if (sched_getaffinity(tid, sizeof(set), &set) != 0 ||
+            !CPU_EQUAL(&set, &rules[rule].set)) {
+            /* Threads are renamed by the JVM: only a thread bound by the
+             * same rule before counts as a violation */
+            if (was_pinned(tid) == rule) {
+                violations++;
+                log_error("Thread %d (%s) left its CPUs, binding it again",
+                          (int)tid, name);
+            }
+            if (sched_setaffinity(tid, sizeof(cpu_set_t), &rules[rule].set) != 0) {
+                if (errno != ESRCH)
+                    log_error("Cannot bind thread %d (%s): %s", (int)tid, name,
+                              strerror(errno));
+                continue;
+            }
+            log_debug("Thread %d (%s) bound to CPUs %s", (int)tid, name,
+                      rules[rule].cpus);
+        }
+        if (cnum == csize) {
+            pinned_thread *grown;
+
+            csize = csize == 0 ? 64 : csize * 2;
+            grown = (pinned_thread *)realloc(current, csize * sizeof(pinned_thread));
+            /* The threads of the previous scan stay the known ones */
+            if (grown == NULL) {
+                log_error("Cannot allocate the pinned thread list");
+                free(current);
+                closedir(dir);
+                return false;
+            }
+            current = grown;
+        }
+        current[cnum].tid = tid;
+        current[cnum].rule = rule;
+        cnum++;
+    }
+    closedir(dir);
+
+    free(pinned);
+    pinned = current;
+    pnum = cnum;
+    if (pnum == before && violations == seen)
+        return false;
+    status_set("pinned_threads", "%d", pnum);
+    status_set("affinity_violations", "%ld", violations);
+    return true;
+}
+
+void placement_report(arg_data *args, pid_t pid)
+{
+    unsigned long requested[MASK_LONGS(NODE_BITS)];
+    unsigned long effective[MASK_LONGS(NODE_BITS)];
+    unsigned long long pages[64];
+    unsigned long long outside = 0, total = 0;
+    char buf[1024];
+    char path[64];
+    char line[4096];
+    char *token, *save;
+    int mode, node, x;
+    size_t len;
+    FILE *file;
+
+    if (read_proc_status(pid, "Cpus_allowed_list", buf, sizeof(buf))) {
+        status_set("cpus", "%s", buf);
+        if (args->cpus != NULL &&
+            parse_list(args->cpus, requested, NODE_BITS) &&
+            parse_list(buf, effective, NODE_BITS) &&
+            memcmp(requested, effective, sizeof(requested)) != 0)
+            log_error("Process %d runs on CPUs %s instead of %s", pid, buf,
+                      args->cpus);
+    }
+    if (read_proc_status(pid, "Mems_allowed_list", buf, sizeof(buf)))
+        status_set("mems", "%s", buf);
+
+    if (args->numa == NULL || numa_nodes(args->numa, &mode, requested) != true)
+        return;
+
+    /* Anonymous pages (heap, stacks...) per node: file pages may have been
+     * read before the policy was set */
+    snprintf(path, sizeof(path), "/proc/%d/numa_maps", (int)pid);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        log_debug("Cannot read %s", path);
+        return;
+    }
+    memset(pages, 0, sizeof(pages));
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strstr(line, " file=") != NULL)
+            continue;
+        for (token = strtok_r(line, " \n", &save); token != NULL;
+             token = strtok_r(NULL, " \n", &save)) {
+            unsigned long long count;
+
+            if (sscanf(token, "N%d=%llu", &node, &count) != 2 ||
+                node < 0 || node >= 64)
+                continue;
+            pages[node] += count;
+            total += count;
+            if (!is_set(requested, node))
+                outside += count;
+        }
+    }
+    fclose(file);
+
+    buf[0] = '\0';
+    for (x = 0; x < 64; x++) {
+        if (pages[x] == 0)
+            continue;
+        len = strlen(buf);
+        snprintf(buf + len, sizeof(buf) - len, "%sN%d=%llu", len ? "," : "",
+                 x, pages[x]);
+    }
+    status_set("numa", "%s", args->numa);
+    status_set("numa_pages", "%s", buf);
+    log_debug("NUMA pages of process %d: %s", pid, buf);
+    if (mode == MPOL_BIND && outside > 0)
+        log_error("%llu of %llu pages of process %d are outside NUMA nodes %s",
+                  outside, total, pid, args->numa);
+}
@@ -0,0 +1,176 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include "deimos.h"
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+/* I/O priorities, from linux/ioprio.h */
+#define IOPRIO_CLASS_SHIFT  13
+#define IOPRIO_WHO_PROCESS  1
+#define IOPRIO_PRIO_VALUE(class, data) (((class) << IOPRIO_CLASS_SHIFT) | (data))
+
+/* CPU time a SCHED_FIFO thread may use without blocking, by default */
+#define FIFO_RTTIME_MS 1000
+
+static const char *io_classes[] = { "none", "rt", "be", "idle" };
+
+static bool set_oomscore(const char *score)
+{
+    FILE *file = fopen("/proc/self/oom_score_adj", "w");
+
+    if (file == NULL || fprintf(file, "%s\n", score) < 0 || fclose(file) != 0) {
+        log_error("Cannot set the OOM score adjustment to %s: %s", score,
+                  strerror(errno));
+        return false;
+    }
+    log_debug("OOM score adjustment set to %s", score);
+    return true;
+}
+
+static bool set_ioprio(const char *ioprio)
+{
+    const char *colon = strchr(ioprio, ':');
+    size_t len = colon == NULL ? strlen(ioprio) : (size_t)(colon - ioprio);
+    int class, level = colon == NULL ? 4 : atoi(colon + 1);
+
+    for (class = 1; class < 4; class++) {
+        if (strlen(io_classes[class]) == len &&
+            strncmp(io_classes[class], ioprio, len) == 0)
+            break;
+    }
+    /* The idle class has no level */
+    if (class == 3)
+        level = 0;
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                IOPRIO_PRIO_VALUE(class, level)) != 0) {
+        log_error("Cannot set the I/O priority to %s: %s", ioprio,
+                  strerror(errno));
+        return false;
+    }
+    log_debug("I/O priority set to %s", ioprio);
+    return true;
+}
+
+static bool set_nice(const char *nice)
+{
+    if (setpriority(PRIO_PROCESS, 0, atoi(nice)) != 0) {
+        log_error("Cannot set the nice level to %s: %s", nice, strerror(errno));
+        return false;
+    }
+    log_debug("Nice level set to %s", nice);
+    return true;
+}
+
+static bool set_sched(const char *sched)
+{
+    struct sched_param param;
+    struct rlimit limit;
+    const char *arg;
+    int policy;
+
+    param.sched_priority = 0;
+    if (strcmp(sched, "batch") == 0)
+        policy = SCHED_BATCH;
+    else if (strcmp(sched, "idle") == 0)
+        policy = SCHED_IDLE;
+    else if (strncmp(sched, "fifo:", 5) == 0) {
+        policy = SCHED_FIFO;
+        param.sched_priority = atoi(sched + 5);
+
+        /* A thread spinning without blocking gets SIGXCPU, then SIGKILL:
+         * the controller restarts the service instead of losing the CPU */
+        arg = strchr(sched + 5, ':');
+        limit.rlim_cur = (rlim_t)(arg == NULL ? FIFO_RTTIME_MS : atol(arg + 1)) * 1000;
+        limit.rlim_max = limit.rlim_cur + 1000000;
+        if (setrlimit(RLIMIT_RTTIME, &limit) != 0) {
+            log_error("Cannot bound the real time CPU usage: %s",
+                      strerror(errno));
+            return false;
+        }
+    }
+    else
+        policy = SCHED_OTHER;
+
+    if (sched_setscheduler(0, policy, &param) != 0) {
+        log_error("Cannot set the scheduling policy to %s: %s", sched,
+                  strerror(errno));
+        return false;
+    }
+    log_debug("Scheduling policy set to %s", sched);
+    return true;
+}
+
+bool priority_apply(arg_data *args)
+{
+    if (args->oomscore != NULL && set_oomscore(args->oomscore) != true)
+        return false;
+    if (args->ioprio != NULL && set_ioprio(args->ioprio) != true)
+        return false;
+    if (args->nice != NULL && set_nice(args->nice) != true)
+        return false;
+    if (args->sched != NULL && set_sched(args->sched) != true)
+        return false;
+    return true;
+}
+
+void priority_report(pid_t pid)
+{
+    struct sched_param param;
+    char path[64];
+    char buf[32];
+    FILE *file;
+    int value;
+
+    value = sched_getscheduler(pid);
+    if (value == SCHED_FIFO || value == SCHED_RR) {
+        sched_getparam(pid, &param);
+        status_set("sched", "%s:%d", value == SCHED_FIFO ? "fifo" : "rr",
+                   param.sched_priority);
+    }
+    else if (value >= 0) {
+        status_set("sched", "%s", value == SCHED_BATCH ? "batch" :
+                   value == SCHED_IDLE ? "idle" : "other");
+    }
+
+    errno = 0;
+    value = getpriority(PRIO_PROCESS, pid);
+    if (errno == 0)
+        status_set("nice", "%d", value);
+
+    value = (int)syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, pid);
+    if (value >= 0) {
+        if ((value >> IOPRIO_CLASS_SHIFT) == 0)
+            status_set("ioprio", "none");
+        else
+            status_set("ioprio", "%s:%d", io_classes[(value >> IOPRIO_CLASS_SHIFT) & 3],
+                       value & ((1 << IOPRIO_CLASS_SHIFT) - 1));
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/oom_score_adj", (int)pid);
+    file = fopen(path, "r");
+    if (file != NULL) {
+        if (fgets(buf, sizeof(buf), file) != NULL) {
+            buf[strcspn(buf, "\n")] = '\0';
+            status_set("oom_score_adj", "%s", buf);
+        }
+        fclose(file);
+    }
+}
@@ -0,0 +1,460 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include "deimos.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+
+/* Files up to this size are mapped and populated in one go */
+#define SMALL_FILE (1024 * 1024)
+/* Larger ones are read ahead by chunks */
+#define CHUNK      (4 * 1024 * 1024)
+#define MAX_THREADS 64
+/* Threads replaying a working set when -readahead is not given */
+#define REPLAY_THREADS 4
+/* Extents recorded on one line, the path is repeated on the next ones */
+#define LINE_EXTENTS 256
+
+typedef struct {
+    char *path;
+    long long size;
+    long long micros;
+    /* Offset and length pairs of the pages to read, or all of them */
+    long long *extents;
+    int xnum;
+} file_entry;
+
+static file_entry *files = NULL;
+static int fnum = 0;
+static int fsize = 0;
+static int next = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t threads[MAX_THREADS];
+static int tnum = 0;
+static long long started;
+
+static long long now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static file_entry *add_file(const char *path)
+{
+    struct stat st;
+    int x;
+
+    if (path == NULL || *path == '\0' || stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return NULL;
+    for (x = 0; x < fnum; x++) {
+        if (strcmp(files[x].path, path) == 0)
+            return &files[x];
+    }
+    if (fnum == fsize) {
+        fsize = fsize == 0 ? 32 : fsize * 2;
+        files = (file_entry *)realloc(files, fsize * sizeof(file_entry));
+    }
+    files[fnum].path = strdup(path);
+    files[fnum].size = st.st_size;
+    files[fnum].micros = -1;
+    files[fnum].extents = NULL;
+    files[fnum].xnum = 0;
+    return &files[fnum++];
+}
+
+/* Strip the last component of a path */
+static char *parent(char *path)
+{
+    char *slash = strrchr(path, '/');
+
+    if (slash != NULL)
+        *slash = '\0';
+    return path;
+}
+
+static void add_glob(const char *pattern)
+{
+    glob_t found;
+    size_t x;
+
+    if (glob(pattern, 0, NULL, &found) != 0)
+        return;
+    for (x = 0; x < found.gl_pathc; x++)
+        add_file(found.gl_pathv[x]);
+    globfree(&found);
+}
+
+/* Bring the recorded pages of a file in the page cache */
+static bool load_extents(int fd, file_entry *file)
+{
+    long long offset, length;
+    int x;
+
+    for (x = 0; x < file->xnum; x++) {
+        offset = file->extents[2 * x];
+        length = file->extents[2 * x + 1];
+        if (offset >= file->size)
+            continue;
+        if (readahead(fd, offset, length) != 0)
+            posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+    }
+    close(fd);
+    return true;
+}
+
+/* Bring a whole file in the page cache */
+static bool load(file_entry *file)
+{
+    const char *path = file->path;
+    long long size = file->size;
+    long long offset;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    if (file->extents != NULL)
+        return load_extents(fd, file);
+    if (size <= SMALL_FILE) {
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (map != MAP_FAILED) {
+            munmap(map, size);
+            close(fd);
+            return true;
+        }
+    }
+    for (offset = 0; offset < size; offset += CHUNK) {
+        if (readahead(fd, offset, CHUNK) != 0) {
+            /* Not supported by the file system: just hint the kernel */
+            posix_fadvise(fd, offset, size - offset, POSIX_FADV_WILLNEED);
+            break;
+        }
+    }
+    close(fd);
+    return true;
+}
+
+static void *worker(void *unused)
+{
+    long long start;
+    int x;
+
+    (void)unused;
+    while (true) {
+        pthread_mutex_lock(&lock);
+        x = next++;
+        pthread_mutex_unlock(&lock);
+        if (x >= fnum)
+            return NULL;
+        start = now_us();
+        if (load(&files[x]))
+            files[x].micros = now_us() - start;
+    }
+}
+
+/* Add the files and extents of a working set recorded by readahead_record().
+ * Each line lists page extents as <first>:<count>, then a tab and a path.
+ * The extents of a file may span several lines, of any length.
+ */
+static int replay(const char *path)
+{
+    char *line = NULL;
+    size_t size = 0;
+    char *tab, *extent, *save;
+    long long first, count;
+    long page = 0;
+    file_entry *file;
+    FILE *set;
+    int added = 0;
+
+    set = fopen(path, "r");
+    if (set == NULL)
+        return 0;
+    if (getline(&line, &size, set) < 0 ||
+        sscanf(line, "# deimos working set, page size %ld", &page) != 1 ||
+        page <= 0) {
+        log_error("Invalid working set %s", path);
+        free(line);
+        fclose(set);
+        return 0;
+    }
+    while (getline(&line, &size, set) >= 0) {
+        line[strcspn(line, "\n")] = '\0';
+        tab = strchr(line, '\t');
+        if (tab == NULL)
+            continue;
+        *tab = '\0';
+        /* Files gone since the recording are skipped */
+        file = add_file(tab + 1);
+        if (file == NULL)
+            continue;
+        if (file->extents == NULL)
+            added++;
+        for (extent = strtok_r(line, ",", &save); extent != NULL;
+             extent = strtok_r(NULL, ",", &save)) {
+            if (sscanf(extent, "%lld:%lld", &first, &count) != 2)
+                continue;
+            file->extents = (long long *)realloc(file->extents,
+                                                 (file->xnum + 1) * 2 * sizeof(long long));
+            file->extents[2 * file->xnum] = first * page;
+            file->extents[2 * file->xnum + 1] = count * page;
+            file->xnum++;
+        }
+    }
+    free(line);
+    fclose(set);
+    return added;
+}
+
+void readahead_start(arg_data *args, home_data *data)
+{
+    char path[PATH_MAX];
+    char *libf, *option, *cp, *entry, *save;
+    int workers = args->readahead;
+    int x;
+
+    started = now_us();
+
+    /* The pages the last start used, read first as they are known precisely */
+    if (args->workingset != NULL && replay(args->workingset) > 0) {
+        log_debug("Replaying working set %s (%d files)", args->workingset, fnum);
+        if (workers <= 0)
+            workers = REPLAY_THREADS;
+    }
+    if (workers <= 0)
+        return;
+
+    /* The JVM and the libraries next to it, in the order they are needed */
+    libf = java_library(args, data);
+    if (libf != NULL) {
+        add_file(libf);
+        snprintf(path, sizeof(path), "%s", libf);
+        add_file(strcat(parent(path), "/classes.jsa"));
+        parent(parent(path));
+        add_glob(strcat(path, "/*.so"));
+    }
+    option = find_option(args, "-XX:SharedArchiveFile=");
+    if (option != NULL)
+        add_file(option + strlen("-XX:SharedArchiveFile="));
+
+    /* The class library, of a JDK 9+ or of a JRE 8 */
+    snprintf(path, sizeof(path), "%s/lib/modules", data->path);
+    add_file(path);
+    snprintf(path, sizeof(path), "%s/jre/lib/rt.jar", data->path);
+    add_file(path);
+    snprintf(path, sizeof(path), "%s/lib/rt.jar", data->path);
+    add_file(path);
+
+    /* The application */
+    add_file(args->jar);
+    option = find_option(args, "-Djava.class.path=");
+    if (option != NULL) {
+        cp = strdup(option + strlen("-Djava.class.path="));
+        for (entry = strtok_r(cp, ":", &save); entry != NULL;
+             entry = strtok_r(NULL, ":", &save))
+            add_file(entry);
+        free(cp);
+    }
+
+    for (x = 0; x < workers && x < fnum; x++) {
+        if (pthread_create(&threads[tnum], NULL, worker, NULL) != 0) {
+            log_error("Cannot start readahead thread: %s", strerror(errno));
+            break;
+        }
+        tnum++;
+    }
+    log_debug("Reading ahead %d files on %d threads", fnum, tnum);
+}
+
+void readahead_wait(void)
+{
+    long long total = 0;
+    int x;
+
+    if (fnum == 0)
+        return;
+    for (x = 0; x < tnum; x++)
+        pthread_join(threads[x], NULL);
+
+    for (x = 0; x < fnum; x++) {
+        if (files[x].micros < 0)
+            log_debug("Readahead of %s failed", files[x].path);
+        else
+            log_debug("Readahead of %s (%lld kB, %d extents) in %lld us", files[x].path,
+                      files[x].size / 1024, files[x].xnum, files[x].micros);
+        total += files[x].size;
+        free(files[x].path);
+        free(files[x].extents);
+    }
+    log_debug("Readahead of %d files (%lld kB) done in %lld ms", fnum, total / 1024,
+              (now_us() - started) / 1000);
+    free(files);
+    files = NULL;
+    fnum = fsize = next = tnum = 0;
+}
+
+/* Append the resident pages of a file to a working set */
+static bool record_file(FILE *set, const char *path, long page)
+{
+    unsigned char *vec;
+    long long pages, x, first = -1;
+    int extents = 0;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    pages = (st.st_size + page - 1) / page;
+    vec = (unsigned char *)malloc(pages);
+    if (mincore(map, st.st_size, vec) == 0) {
+        for (x = 0; x <= pages; x++) {
+            if (x < pages && (vec[x] & 1)) {
+                if (first < 0)
+                    first = x;
+                continue;
+            }
+            if (first >= 0) {
+                fprintf(set, "%s%lld:%lld", extents % LINE_EXTENTS ? "," : "",
+                        first, x - first);
+                first = -1;
+                if (++extents % LINE_EXTENTS == 0)
+                    fprintf(set, "\t%s\n", path);
+            }
+        }
+        if (extents % LINE_EXTENTS != 0)
+            fprintf(set, "\t%s\n", path);
+    }
+    free(vec);
+    munmap(map, st.st_size);
+    return extents > 0;
+}
+
+static bool recorded(char **paths, int count, const char *path)
+{
+    int x;
+
+    for (x = 0; x < count; x++) {
+        if (strcmp(paths[x], path) == 0)
+            return true;
+    }
+    return false;
+}
+
+/* Collect a file once, skipping special and deleted ones */
+static void collect(char ***paths, int *count, const char *path)
+{
+    struct stat st;
+
+    if (path[0] != '/' || strstr(path, " (deleted)") != NULL ||
+        recorded(*paths, *count, path) || stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return;
+    *paths = (char **)realloc(*paths, (*count + 1) * sizeof(char *));
+    (*paths)[(*count)++] = strdup(path);
+}
+
+void readahead_record(arg_data *args, pid_t pid)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    char line[PATH_MAX + 256];
+    char link[PATH_MAX];
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    char **paths = NULL;
+    int count = 0, written = 0, x;
+    struct dirent *entry;
+    char *name;
+    ssize_t len;
+    FILE *file;
+    DIR *dir;
+
+    /* Only the first start records, deleting the file records again */
+    if (args->workingset == NULL || access(args->workingset, F_OK) == 0)
+        return;
+
+    /* Mapped files (libraries, jars, CDS archive...) */
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    file = fopen(path, "r");
+    if (file != NULL) {
+        while (fgets(line, sizeof(line), file) != NULL) {
+            line[strcspn(line, "\n")] = '\0';
+            name = strchr(line, '/');
+            if (name != NULL)
+                collect(&paths, &count, name);
+        }
+        fclose(file);
+    }
+
+    /* Opened files (jars read through a file descriptor, configuration...) */
+    snprintf(path, sizeof(path), "/proc/%d/fd", (int)pid);
+    dir = opendir(path);
+    if (dir != NULL) {
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.')
+                continue;
+            snprintf(path, sizeof(path), "/proc/%d/fd/%s", (int)pid, entry->d_name);
+            len = readlink(path, link, sizeof(link) - 1);
+            if (len <= 0)
+                continue;
+            link[len] = '\0';
+            collect(&paths, &count, link);
+        }
+        closedir(dir);
+    }
+
+    snprintf(temp, sizeof(temp), "%s.tmp", args->workingset);
+    file = fopen(temp, "w");
+    if (file == NULL) {
+        log_error("Cannot write working set %s: %s", temp, strerror(errno));
+    }
+    else {
+        fprintf(file, "# deimos working set, page size %ld\n", page);
+        for (x = 0; x < count; x++) {
+            if (record_file(file, paths[x], page))
+                written++;
+        }
+        if (fclose(file) != 0 || rename(temp, args->workingset) != 0) {
+            log_error("Cannot write working set %s", args->workingset);
+            unlink(temp);
+        }
+        else
+            log_debug("Recorded the working set of %d files in %s", written,
+                      args->workingset);
+    }
+    for (x = 0; x < count; x++)
+        free(paths[x]);
+    free(paths);
+}
@@ -0,0 +1,98 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* Seconds between two reads of smaps_rollup */
+#define STANDBY_REPORT 10
+
+bool standby_wait(int fd)
+{
+    char promote;
+    ssize_t ret;
+
+    log_debug("Standby ready, waiting for a promotion");
+    do {
+        ret = read(fd, &promote, 1);
+    } while (ret < 0 && errno == EINTR);
+    close(fd);
+    if (ret != 1) {
+        log_debug("Controller gone, standby exiting");
+        return false;
+    }
+    log_debug("Standby promoted");
+    return true;
+}
+
+bool standby_promote(int fd)
+{
+    bool promoted = send(fd, "p", 1, MSG_NOSIGNAL) == 1;
+
+    close(fd);
+    return promoted;
+}
+
+bool standby_report(pid_t pid)
+{
+    static time_t last = 0;
+    static long long lastrss = -1;
+    static long long lastpss = -1;
+    long long value, rss = -1, pss = -1;
+    char path[64];
+    char line[128];
+    FILE *file;
+
+    if (pid == 0) {
+        last = 0;
+        if (lastrss == 0 && lastpss == 0)
+            return false;
+        lastrss = lastpss = 0;
+        status_set("standby_rss_kb", "0");
+        status_set("standby_pss_kb", "0");
+        return true;
+    }
+    if (time(NULL) - last < STANDBY_REPORT)
+        return false;
+    last = time(NULL);
+
+    /* Pss shares the pages mapped by both JVMs, like libjvm or the CDS
+     * archive, so it tells what the standby really costs */
+    snprintf(path, sizeof(path), "/proc/%d/smaps_rollup", (int)pid);
+    file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "Rss: %lld kB", &value) == 1)
+            rss = value;
+        else if (sscanf(line, "Pss: %lld kB", &value) == 1)
+            pss = value;
+    }
+    fclose(file);
+    if (rss < 0 || pss < 0 || (rss == lastrss && pss == lastpss))
+        return false;
+
+    lastrss = rss;
+    lastpss = pss;
+    status_set("standby_rss_kb", "%lld", rss);
+    status_set("standby_pss_kb", "%lld", pss);
+    log_debug("Standby %d holds %lld kB (%lld kB proportional)", (int)pid,
+              rss, pss);
+    return true;
+}
@@ -0,0 +1,131 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "deimos.h"
+#include <limits.h>
+#include <unistd.h>
+
+#define STATUS_ENTRIES 64
+#define STATUS_KEY     32
+#define STATUS_VALUE   512
+
+typedef struct {
+    char key[STATUS_KEY];
+    char value[STATUS_VALUE];
+} status_entry;
+
+static status_entry entries[STATUS_ENTRIES];
+static int count = 0;
+
+void status_set(const char *key, const char *format, ...)
+{
+    va_list ap;
+    int x;
+
+    for (x = 0; x < count; x++) {
+        if (strcmp(entries[x].key, key) == 0)
+            break;
+    }
+    if (x == STATUS_ENTRIES) {
+        log_error("Too many status values, ignoring %s", key);
+        return;
+    }
+    if (x == count) {
+        snprintf(entries[x].key, STATUS_KEY, "%s", key);
+        count++;
+    }
+    va_start(ap, format);
+    vsnprintf(entries[x].value, STATUS_VALUE, format, ap);
+    va_end(ap);
+}
+
+bool status_write(arg_data *args)
+{
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    FILE *file;
+    int x;
+
+    snprintf(path, sizeof(path), "%s.status", args->pidf);
+    snprintf(temp, sizeof(temp), "%s.status.tmp", args->pidf);
+    file = fopen(temp, "w");
+    if (file == NULL) {
+        log_debug("Cannot write status file %s", temp);
+        return false;
+    }
+    for (x = 0; x < count; x++)
+        fprintf(file, "%s=%s\n", entries[x].key, entries[x].value);
+    if (fclose(file) != 0 || rename(temp, path) != 0) {
+        log_debug("Cannot write status file %s", path);
+        unlink(temp);
+        return false;
+    }
+    return true;
+}
+
+void status_remove(arg_data *args)
+{
+    char path[PATH_MAX];
+    char value[32];
+
+    /* Not the file of another deimos running with the same pid file */
+    if (status_get(args, "controller", value, sizeof(value)) != true ||
+        atoi(value) != (int)getpid())
+        return;
+    snprintf(path, sizeof(path), "%s.status", args->pidf);
+    unlink(path);
+}
+
+int status_print(arg_data *args)
+{
+    char path[PATH_MAX];
+    char buf[1024];
+    FILE *file;
+
+    snprintf(path, sizeof(path), "%s.status", args->pidf);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        log_error("No status in %s, is deimos running?", path);
+        return 1;
+    }
+    while (fgets(buf, sizeof(buf), file) != NULL)
+        fputs(buf, stdout);
+    fclose(file);
+    return 0;
+}
+
+bool status_get(arg_data *args, const char *key, char *value, size_t len)
+{
+    char path[PATH_MAX];
+    char buf[STATUS_KEY + STATUS_VALUE + 2];
+    size_t keylen = strlen(key);
+    bool found = false;
+    FILE *file;
+
+    snprintf(path, sizeof(path), "%s.status", args->pidf);
+    file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+    while (found == false && fgets(buf, sizeof(buf), file) != NULL) {
+        if (strncmp(buf, key, keylen) == 0 && buf[keylen] == '=') {
+            buf[strcspn(buf, "\n")] = '\0';
+            snprintf(value, len, "%s", buf + keylen + 1);
+            found = true;
+        }
+    }
+    fclose(file);
+    return found;
+}
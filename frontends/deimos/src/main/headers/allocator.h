@@ -0,0 +1,59 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_ALLOCATOR_H__
+#define __DEIMOS_ALLOCATOR_H__
+
+/**
+ * Set up the environment selecting the native allocator of the JVM and its
+ * arenas and tunables (LD_PRELOAD, MALLOC_ARENA_MAX, GLIBC_TUNABLES or
+ * MALLOC_CONF). Called just before deimos re-executes itself, as they are
+ * only read when a process starts.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the environment was set up.
+ */
+bool allocator_environ(arg_data *args);
+
+/**
+ * Preload a library in the re-executed process, before the other ones.
+ *
+ * @param library The path of the library.
+ */
+void allocator_preload(const char *library);
+
+/**
+ * Check the allocator selected with -malloc is the one serving malloc()
+ * in the re-executed process.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if it is, or if no allocator was selected.
+ */
+bool allocator_check(arg_data *args);
+
+/**
+ * Publish the active allocator and its arena limit in the status.
+ */
+void allocator_report(void);
+
+/**
+ * Give the free memory of the active allocator back to the system:
+ * malloc_trim() with glibc, a purge of every arena with jemalloc, and
+ * ReleaseFreeMemory with tcmalloc.
+ */
+void allocator_trim(void);
+
+#endif /* ifndef __DEIMOS_ALLOCATOR_H__ */
@@ -62,8 +62,106 @@ typedef struct {
     bool pause;
     /** Continue to a running deimos*/
     bool resume;
+    /** Print the status of a running deimos */
+    bool status;
+    /** Restart a running deimos, overlapping the old and new JVMs */
+    bool restart;
+    /** Pause a running deimos and give its free memory back */
+    bool hibernate;
+    /** Pause a running deimos and stop all its threads */
+    bool freeze;
     /** number of seconds to until service started */
     int wait;
+    /** Minimal number of seconds between two starts of the service */
+    int rdelay;
+    /** Whether to reload the service in the running JVM or not. */
+    bool hotreload;
+    /** Whether to touch the memory of a hibernated JVM again on resume. */
+    bool retouch;
+    /** Seconds given to the new JVM of a restart to get ready. */
+    int switchtime;
+    /** Number of JVMs running the service, each with its own controller. */
+    int replicas;
+    /** How far a standby JVM gets before waiting (create or load). */
+    char *standby;
+    /** Whether to size the JVM from the cgroup limits or not. */
+    bool autosize;
+    /** Percentage of the cgroup memory given to the heap. */
+    int heappct;
+    /** Percentage of the cgroup memory given to the metaspace. */
+    int metapct;
+    /** Percentage of the cgroup memory given to direct buffers. */
+    int directpct;
+    /** Mount point of the cgroup file systems. */
+    char *cgroup;
+    /** CPUs the JVM is bound to. */
+    char *cpus;
+    /** NUMA nodes the JVM memory is bound to, or interleaved on. */
+    char *numa;
+    /** Transparent huge pages mode (always, madvise or never). */
+    char *thp;
+    /** RLIMIT_MEMLOCK of the JVM (a size or "unlimited"). */
+    char *memlock;
+    /** Whether to lock all the JVM memory or not. */
+    bool mlockall;
+    /** Scheduling policy (other, batch, idle or fifo:<priority>[:<ms>]). */
+    char *sched;
+    /** Nice level of the JVM. */
+    char *nice;
+    /** I/O scheduling class and level (rt, be or idle[:<level>]). */
+    char *ioprio;
+    /** OOM killer score adjustment of the JVM. */
+    char *oomscore;
+    /** Thread name patterns and the CPUs of the matching threads. */
+    char **threadcpus;
+    /** Number of thread affinity rules. */
+    int tcnum;
+    /** Nice level of the JVM until it is ready. */
+    char *boost;
+    /** CPUs the JVM runs on until it is ready. */
+    char *boostcpus;
+    /** Maximum duration of the startup boost, in seconds. */
+    int boosttime;
+    /** Addresses listened on by deimos on behalf of the JVM. */
+    char **listen;
+    /** Number of listening addresses. */
+    int lnum;
+    /** Whether to start the JVM on the first connection only. */
+    bool lazy;
+    /** Seconds without connections before a lazy JVM is shut down. */
+    int idletime;
+    /** Resident memory of the JVM, in MB, triggering a restart (0 for none). */
+    int guardrss;
+    /** Number of JVM threads triggering a restart (0 for none). */
+    int guardthreads;
+    /** Number of JVM descriptors triggering a restart (0 for none). */
+    int guardfds;
+    /** Seconds of JVM uptime triggering a restart (0 for none). */
+    int guarduptime;
+    /** Seconds between two samples of the JVM by the leak guard. */
+    int guardinterval;
+    /** Local time window "HH:MM-HH:MM" for the guard restarts. */
+    char *guardwindow;
+    /** Whether the guard restarts overlap the old and new JVMs or not. */
+    bool guardoverlap;
+    /** Lease file shared by the instances of an active/standby pair. */
+    char *lease;
+    /** Seconds without a heartbeat before the lease lapses. */
+    int leasetime;
+    /** Number of threads reading the JVM files ahead (0 for none). */
+    int readahead;
+    /** File recording the pages read during the startup. */
+    char *workingset;
+    /** Whether to make the JVM memory mergeable by KSM or not. */
+    bool ksm;
+    /** Library making the memory mergeable on older kernels. */
+    char *ksmshim;
+    /** Native allocator (glibc, jemalloc, tcmalloc or a library path). */
+    char *malloc;
+    /** Maximum number of allocator arenas. */
+    int arenas;
+    /** Allocator tunables (GLIBC_TUNABLES or MALLOC_CONF syntax). */
+    char *malloctune;
     /** Destination for stdout */
     char *outfile;
     /** Destination for stderr */
@@ -86,6 +184,32 @@ typedef struct {
  */
 arg_data *arguments(int argc, char *argv[]);
 
+/**
+ * Find a JVM option.
+ *
+ * @param args The parsed command line arguments.
+ * @param prefix The beginning of the option.
+ * @return The last option starting with prefix, or NULL if none was found.
+ */
+char *find_option(arg_data *args, const char *prefix);
+
+/**
+ * Append an option to the JVM options.
+ *
+ * @param args The parsed command line arguments.
+ * @param option The option to append (copied).
+ * @return true if the option was appended.
+ */
+bool add_option(arg_data *args, const char *option);
+
+/**
+ * Parse a size the way the JVM does (4096, 64k, 512m, 2g).
+ *
+ * @param size The size to parse.
+ * @return The size in bytes, or 0 if it is invalid.
+ */
+unsigned long long parse_size(const char *size);
+
 #ifdef __cplusplus
 }
 #endif
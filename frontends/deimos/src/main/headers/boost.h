@@ -0,0 +1,48 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_BOOST_H__
+#define __DEIMOS_BOOST_H__
+
+/**
+ * Raise the priority of the child to the -boost nice level for its startup.
+ * Called before switching user and dropping the capabilities, like the
+ * other priorities. The wider -boostcpus set is applied by placement_apply().
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the boost was applied (or none was requested).
+ */
+bool boost_apply(arg_data *args);
+
+/**
+ * Check whether a startup boost was requested.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if -boost or -boostcpus was given.
+ */
+bool boost_enabled(arg_data *args);
+
+/**
+ * Bring every thread of a started child back to its steady nice level and
+ * CPUs, once it is ready or the boost has lasted -boosttime seconds.
+ *
+ * @param args The parsed command line arguments.
+ * @param pid The pid of the child.
+ * @param elapsed How long the boost lasted, in milliseconds.
+ */
+void boost_drop(arg_data *args, pid_t pid, long long elapsed);
+
+#endif /* ifndef __DEIMOS_BOOST_H__ */
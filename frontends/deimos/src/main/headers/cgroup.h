@@ -0,0 +1,65 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_CGROUP_H__
+#define __DEIMOS_CGROUP_H__
+
+typedef struct cgroup_data cgroup_data;
+
+struct cgroup_data
+{
+    /** Version of the cgroup hierarchy (1 or 2), 0 if none was found. */
+    int version;
+    /** Hard memory limit in bytes, 0 if unlimited. */
+    unsigned long long memmax;
+    /** Memory throttling threshold in bytes, 0 if none. */
+    unsigned long long memhigh;
+    /** CPU bandwidth quota in thousandths of CPU, 0 if unlimited. */
+    unsigned long long cpuquota;
+    /** Number of CPUs of the cpuset, 0 if unknown. */
+    int cpuset;
+};
+
+/**
+ * Read the cgroup (v2 or v1) limits applying to the current process.
+ *
+ * @param root The mount point of the cgroup file systems.
+ * @param data The structure receiving the limits.
+ * @return true if a cgroup hierarchy was found under root.
+ */
+bool cgroup_limits(const char *root, cgroup_data *data);
+
+/**
+ * Find the cgroup of this process for a controller in /proc/self/cgroup.
+ *
+ * @param controller The controller name, or "" for the unified hierarchy.
+ * @param path The buffer receiving the cgroup path, relative to the mount
+ *             point of the hierarchy.
+ * @param len The size of the buffer.
+ * @return true if the cgroup was found.
+ */
+bool cgroup_self(const char *controller, char *path, int len);
+
+/**
+ * Derive the heap, metaspace, direct memory and processor count options
+ * of the JVM from the cgroup limits, and append them to the JVM options.
+ * Options explicitly specified on the command line are left untouched.
+ *
+ * @param args The parsed command line arguments.
+ */
+void cgroup_autosize(arg_data *args);
+
+#endif /* ifndef __DEIMOS_CGROUP_H__ */
@@ -38,6 +38,21 @@ typedef enum {
 #include "debug.h"
 #include "arguments.h"
 #include "home.h"
+#include "cgroup.h"
+#include "status.h"
+#include "placement.h"
+#include "hugepages.h"
+#include "priority.h"
+#include "boost.h"
+#include "allocator.h"
+#include "readahead.h"
+#include "ksm.h"
+#include "listen.h"
+#include "standby.h"
+#include "hibernate.h"
+#include "freeze.h"
+#include "guard.h"
+#include "lease.h"
 #include "location.h"
 #include "replace.h"
 #include "dso.h"
@@ -0,0 +1,70 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_FREEZE_H__
+#define __DEIMOS_FREEZE_H__
+
+/**
+ * Freeze the service once paused: move the child to a cgroup of its own
+ * under its current one and freeze it, or stop it with SIGSTOP when there
+ * is no cgroup freezer. "/tmp/<pid>.deimos_frozen" tells the controller and
+ * the commands how to thaw it. Called by the main thread of the child,
+ * returns once thawed.
+ *
+ * @param args The parsed command line arguments.
+ */
+void freeze_enter(arg_data *args);
+
+/**
+ * Thaw a frozen child, and note the time for the thaw to ready latency.
+ *
+ * @param pid The pid of the child.
+ * @return true if the child was frozen.
+ */
+bool freeze_thaw(pid_t pid);
+
+/**
+ * Tell whether a child is frozen, with every thread stopped.
+ *
+ * @param pid The pid of the child.
+ * @return true if the child is frozen.
+ */
+bool freeze_frozen(pid_t pid);
+
+/**
+ * Record the thaw to ready latency once the service is resumed. Called by
+ * the child after every resume.
+ */
+void freeze_ready(void);
+
+/**
+ * Read the thaw to ready latency of the last thaw of a child.
+ *
+ * @param pid The pid of the child.
+ * @return The latency in milliseconds, or -1 while not ready.
+ */
+long freeze_latency(pid_t pid);
+
+/**
+ * Publish whether a child is frozen, and the latency of its last thaw.
+ * Called by the controller on every tick.
+ *
+ * @param pid The pid of the child.
+ * @return true if the figures changed.
+ */
+bool freeze_report(pid_t pid);
+
+#endif /* ifndef __DEIMOS_FREEZE_H__ */
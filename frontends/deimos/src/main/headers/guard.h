@@ -0,0 +1,77 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_GUARD_H__
+#define __DEIMOS_GUARD_H__
+
+typedef struct guard_data guard_data;
+
+struct guard_data
+{
+    /** Resident memory of the JVM in kB. */
+    long rss;
+    /** Number of threads of the JVM. */
+    int threads;
+    /** Number of open file descriptors of the JVM. */
+    int fds;
+};
+
+/**
+ * Tell whether any leak guard threshold (or a maximum uptime) is set.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the controller has to sample the JVM.
+ */
+bool guard_enabled(arg_data *args);
+
+/**
+ * Read the resident memory, thread and descriptor counts of a JVM in /proc.
+ *
+ * @param pid The pid of the JVM.
+ * @param data The structure receiving the figures.
+ * @return true if the process could be read.
+ */
+bool guard_sample(pid_t pid, guard_data *data);
+
+/**
+ * Check the figures of a JVM against the leak guard thresholds.
+ *
+ * @param args The parsed command line arguments.
+ * @param data The figures of the JVM.
+ * @param uptime The time the JVM has been running, in seconds.
+ * @return The name of the threshold crossed, NULL if none.
+ */
+const char *guard_check(arg_data *args, guard_data *data, long uptime);
+
+/**
+ * Parse a time window "HH:MM-HH:MM", which may span midnight.
+ *
+ * @param window The window.
+ * @param start Receives the first minute of the window in the day.
+ * @param end Receives the minute ending the window.
+ * @return true if the window is valid.
+ */
+bool guard_window(const char *window, int *start, int *end);
+
+/**
+ * Tell whether a planned restart may happen now.
+ *
+ * @param args The parsed command line arguments.
+ * @return true when no -guardwindow is set, or in the window (local time).
+ */
+bool guard_now(arg_data *args);
+
+#endif /* ifndef __DEIMOS_GUARD_H__ */
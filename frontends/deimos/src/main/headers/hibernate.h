@@ -0,0 +1,56 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_HIBERNATE_H__
+#define __DEIMOS_HIBERNATE_H__
+
+/**
+ * Hibernate the service: pause it, shrink the Java heap, and give the free
+ * native memory back to the system. The resident memory before and after
+ * is left in "/tmp/<pid>.deimos_hibernated" for the controller and the
+ * hibernate command. Called by the main thread of the child.
+ *
+ * @return true if the service was paused.
+ */
+bool hibernate_enter(void);
+
+/**
+ * Leave hibernation once the service is resumed, touching the writable
+ * memory of the JVM again with -retouch. Called by the main thread of the
+ * child.
+ *
+ * @param args The parsed command line arguments.
+ */
+void hibernate_leave(arg_data *args);
+
+/**
+ * Publish whether a child is hibernated, and its resident memory before and
+ * after. Called by the controller on every tick.
+ *
+ * @param pid The pid of the child.
+ * @return true if the figures changed.
+ */
+bool hibernate_report(pid_t pid);
+
+/**
+ * Read the resident memory of a process.
+ *
+ * @param pid The pid of the process.
+ * @return The resident memory in kB, or -1.
+ */
+long hibernate_rss(pid_t pid);
+
+#endif /* ifndef __DEIMOS_HIBERNATE_H__ */
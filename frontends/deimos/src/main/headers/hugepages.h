@@ -0,0 +1,39 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_HUGEPAGES_H__
+#define __DEIMOS_HUGEPAGES_H__
+
+/**
+ * Raise RLIMIT_MEMLOCK as requested by -memlock or -mlockall. Called in the
+ * child before switching user, as raising the hard limit is privileged.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the limit was raised (or nothing was requested).
+ */
+bool hugepages_memlock(arg_data *args);
+
+/**
+ * Apply the -thp mode, check that enough huge pages are free for a
+ * -XX:+UseLargePages heap and lock the memory with -mlockall. Called in the
+ * child just before the JVM is created.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the JVM can be created with these settings.
+ */
+bool hugepages_apply(arg_data *args);
+
+#endif /* ifndef __DEIMOS_HUGEPAGES_H__ */
@@ -20,10 +20,13 @@
 char *java_library(arg_data *args, home_data *data);
 bool java_init(arg_data *args, home_data *data);
 bool java_destroy(void);
+bool java_listeners(void);
 bool java_load(arg_data *args);
 bool java_signal(void);
 bool java_start(void);
 bool java_stop(void);
+bool java_reload(void);
+bool java_hibernate(void);
 bool java_version(void);
 bool java_check(arg_data *args);
 bool JVM_destroy(int exit);
@@ -0,0 +1,51 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_KSM_H__
+#define __DEIMOS_KSM_H__
+
+/**
+ * With -ksm on a kernel without PR_SET_MEMORY_MERGE, preload the -ksmshim
+ * library making every anonymous mapping mergeable. Called just before
+ * deimos re-executes itself.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the environment was set up.
+ */
+bool ksm_environ(arg_data *args);
+
+/**
+ * Make the memory of the child mergeable by the kernel samepage merging
+ * daemon. Called before switching user and dropping the capabilities, as
+ * PR_SET_MEMORY_MERGE needs CAP_SYS_RESOURCE.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if KSM was enabled (or not requested).
+ */
+bool ksm_apply(arg_data *args);
+
+/**
+ * Publish the pages of a started child merged by KSM, and the memory they
+ * save, from /proc/<pid>/ksm_stat. Called by the controller on every tick,
+ * it only reads them every KSM_REPORT seconds.
+ *
+ * @param args The parsed command line arguments.
+ * @param pid The pid of the child.
+ * @return true if the figures changed.
+ */
+bool ksm_report(arg_data *args, pid_t pid);
+
+#endif /* ifndef __DEIMOS_KSM_H__ */
@@ -0,0 +1,57 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_LEASE_H__
+#define __DEIMOS_LEASE_H__
+
+/**
+ * Open the lease file shared by the instances of an active/standby pair.
+ * Called by the child before dropping its privileges.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the file could be opened.
+ */
+bool lease_open(arg_data *args);
+
+/**
+ * Take the lease, or renew it. The file holds the owner ("<host>:<pid>" of
+ * its child) and the time of its last heartbeat, read and written under an
+ * OFD lock. The lease lapses -leasetime seconds after the last heartbeat,
+ * or as soon as its owner is a dead process of this host. An owner that
+ * cannot renew it gives it up half a lapse after its last renewal, strictly
+ * before a standby may take it over.
+ *
+ * @param args The parsed command line arguments.
+ * @return true while the calling child holds the lease.
+ */
+bool lease_hold(arg_data *args);
+
+/**
+ * Give the lease up on shutdown, so that the standby takes over at once.
+ */
+void lease_release(void);
+
+/**
+ * Publish whether a child holds the lease, and its owner. Called by the
+ * controller on every tick.
+ *
+ * @param args The parsed command line arguments.
+ * @param pid The pid of the child.
+ * @return true if the figures changed.
+ */
+bool lease_report(arg_data *args, pid_t pid);
+
+#endif /* ifndef __DEIMOS_LEASE_H__ */
@@ -0,0 +1,68 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_LISTEN_H__
+#define __DEIMOS_LISTEN_H__
+
+/**
+ * Bind and listen on the -listen addresses. Called once by the controller,
+ * before forking the first child: the sockets outlive the children, so the
+ * kernel queues the connections while a new JVM starts.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if every socket was bound (or none was requested).
+ */
+bool listen_open(arg_data *args);
+
+/**
+ * Hand the listening sockets to a new child following the LISTEN_FDS
+ * convention: they are moved to the descriptors 3 and up, and LISTEN_PID,
+ * LISTEN_FDS and LISTEN_FDNAMES are set.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the sockets were handed over.
+ */
+bool listen_child(arg_data *args);
+
+/**
+ * Wait for a connection on the listening sockets, without accepting it: it
+ * stays in the accept queue for the child (-lazy).
+ *
+ * @param args The parsed command line arguments.
+ * @param ms The maximum time to wait, in milliseconds.
+ * @return true if a connection is pending.
+ */
+bool listen_wait(arg_data *args, int ms);
+
+/**
+ * Count the connections of the listening sockets, established or still in
+ * their accept queue (-idletime). Established ones are read from
+ * /proc/net/tcp and tcp6.
+ *
+ * @param args The parsed command line arguments.
+ * @return The number of connections.
+ */
+int listen_connections(arg_data *args);
+
+/**
+ * Tell whether a listening socket is an IPv6 one.
+ *
+ * @param fd The socket.
+ * @return true for an IPv6 socket.
+ */
+bool listen_inet6(int fd);
+
+#endif /* ifndef __DEIMOS_LISTEN_H__ */
@@ -0,0 +1,77 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_PLACEMENT_H__
+#define __DEIMOS_PLACEMENT_H__
+
+/**
+ * Bind the current process to the CPUs and NUMA nodes given with -cpus and
+ * -numa. Called in the child before the JVM is created, so that all of its
+ * threads and memory inherit the binding.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the binding was applied (or none was requested).
+ */
+bool placement_apply(arg_data *args);
+
+/**
+ * Give a replica of -replicas its slice of the host: with several NUMA
+ * nodes and no -numa nor -cpus, the replicas are spread over the nodes in
+ * turn. The CPUs of -cpus, of the node, or else of the controller are then
+ * split in contiguous slices between the replicas sharing them, and the
+ * slice becomes the -cpus of the replica. Called in the controller of the
+ * replica before its first child is forked.
+ *
+ * @param args The parsed command line arguments.
+ * @param index The index of the replica, from 0.
+ * @return true if the slice could be computed.
+ */
+bool placement_replica(arg_data *args, int index);
+
+/**
+ * Bind a thread of a started child to the CPUs the JVM runs on once the
+ * startup boost is over: those of -cpus, those of the nodes -numa binds the
+ * memory to, or else the CPUs of the controller.
+ *
+ * @param args The parsed command line arguments.
+ * @param tid The thread to bind.
+ * @return true if the thread was bound.
+ */
+bool placement_bind(arg_data *args, pid_t tid);
+
+/**
+ * Bind the threads of a started child to the CPUs of the first -threadcpus
+ * rule matching their name. Called by the controller on every tick once the
+ * child is ready: new threads are bound, and the threads whose affinity was
+ * changed since they were bound are counted as violations and bound again.
+ *
+ * @param args The parsed command line arguments.
+ * @param pid The pid of the child.
+ * @return true if the pinned thread or violation counts changed.
+ */
+bool placement_threads(arg_data *args, pid_t pid);
+
+/**
+ * Check the effective CPUs, memory nodes and NUMA pages of a started child,
+ * publish them in the status and report any difference with the requested
+ * placement.
+ *
+ * @param args The parsed command line arguments.
+ * @param pid The pid of the child.
+ */
+void placement_report(arg_data *args, pid_t pid);
+
+#endif /* ifndef __DEIMOS_PLACEMENT_H__ */
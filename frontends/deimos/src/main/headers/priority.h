@@ -0,0 +1,39 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_PRIORITY_H__
+#define __DEIMOS_PRIORITY_H__
+
+/**
+ * Apply the -sched, -nice, -ioprio and -oomscore settings to the current
+ * process. Called in the child before switching user and dropping the
+ * capabilities, as most of them are privileged. Threads created by the JVM
+ * inherit them.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if all the settings were applied.
+ */
+bool priority_apply(arg_data *args);
+
+/**
+ * Publish the effective scheduling policy, nice level, I/O priority and
+ * OOM score adjustment of a started child in the status.
+ *
+ * @param pid The pid of the child.
+ */
+void priority_report(pid_t pid);
+
+#endif /* ifndef __DEIMOS_PRIORITY_H__ */
@@ -0,0 +1,48 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_READAHEAD_H__
+#define __DEIMOS_READAHEAD_H__
+
+/**
+ * Start reading the JVM library, its CDS archive, the class library and the
+ * application jars into the page cache on -readahead threads, so that a
+ * cold start does not fault them in page by page. The pages of the
+ * -workingset recorded by an earlier start are read first. Called in the
+ * child just before the JVM is created: the reads proceed meanwhile.
+ *
+ * @param args The parsed command line arguments.
+ * @param data The Java Home of the JVM.
+ */
+void readahead_start(arg_data *args, home_data *data);
+
+/**
+ * Record which pages of the files mapped or opened by a ready child are in
+ * the page cache into the -workingset file, unless it exists already. The
+ * next starts read them ahead before the JVM is created.
+ *
+ * @param args The parsed command line arguments.
+ * @param pid The pid of the child.
+ */
+void readahead_record(arg_data *args, pid_t pid);
+
+/**
+ * Wait for the readahead threads started by readahead_start() and log how
+ * long the files took to read.
+ */
+void readahead_wait(void);
+
+#endif /* ifndef __DEIMOS_READAHEAD_H__ */
@@ -0,0 +1,48 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_STANDBY_H__
+#define __DEIMOS_STANDBY_H__
+
+/**
+ * Block a standby child until the controller promotes it. The controller
+ * end of the socket pair closes when it exits, which releases the standby
+ * too.
+ *
+ * @param fd The standby end of the socket pair shared with the controller.
+ * @return true if promoted, false if the controller went away.
+ */
+bool standby_wait(int fd);
+
+/**
+ * Promote a standby child, and close the controller end of its socket pair.
+ *
+ * @param fd The controller end of the socket pair shared with the standby.
+ * @return true if the standby got the promotion.
+ */
+bool standby_promote(int fd);
+
+/**
+ * Publish the memory held by a standby child (standby_rss_kb and
+ * standby_pss_kb, from /proc/<pid>/smaps_rollup). Called by the controller
+ * on every tick, it only reads them every STANDBY_REPORT seconds.
+ *
+ * @param pid The pid of the standby, or 0 once there is none.
+ * @return true if the figures changed.
+ */
+bool standby_report(pid_t pid);
+
+#endif /* ifndef __DEIMOS_STANDBY_H__ */
@@ -0,0 +1,63 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEIMOS_STATUS_H__
+#define __DEIMOS_STATUS_H__
+
+/**
+ * Set a value of the service status, published by the controller in the
+ * "<pidfile>.status" file as "key=value" lines.
+ *
+ * @param key The name of the value.
+ * @param format A printf() format of the value.
+ */
+void status_set(const char *key, const char *format, ...);
+
+/**
+ * Atomically replace the status file with the current values.
+ *
+ * @param args The parsed command line arguments.
+ * @return true if the file was written.
+ */
+bool status_write(arg_data *args);
+
+/**
+ * Remove the status file, if it was written by the calling controller.
+ *
+ * @param args The parsed command line arguments.
+ */
+void status_remove(arg_data *args);
+
+/**
+ * Print the status file of a running deimos (status command).
+ *
+ * @param args The parsed command line arguments.
+ * @return 0 if the status was printed, 1 otherwise.
+ */
+int status_print(arg_data *args);
+
+/**
+ * Read a value from the status file of a running deimos.
+ *
+ * @param args The parsed command line arguments.
+ * @param key The name of the value.
+ * @param value The buffer receiving the value.
+ * @param len The size of the buffer.
+ * @return true if the value was found.
+ */
+bool status_get(arg_data *args, const char *key, char *value, size_t len);
+
+#endif /* ifndef __DEIMOS_STATUS_H__ */
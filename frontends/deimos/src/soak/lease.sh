@@ -0,0 +1,239 @@
+#!/bin/sh
+# Licensed to the Apache Software Foundation (ASF) under one or more
+# contributor license agreements.  See the NOTICE file distributed with
+# this work for additional information regarding copyright ownership.
+# The ASF licenses this file to You under the Apache License, Version 2.0
+# (the "License"); you may not use this file except in compliance with
+# the License.  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Takeover test of an active/standby pair (-lease), running two deimos
+# against the stub libjvm (see src/jvmstub).
+#
+# The holder is killed (SIGKILL), stalled (SIGSTOP then SIGCONT) and shut
+# down cleanly in turn. Every JVM step is logged with its time in a shared
+# events file; the test fails when the standby does not take over within its
+# bound, takes over a stalled holder before the lease lapsed, when the
+# stalled holder does not pause soon after it continues, or when two
+# services ever run at the same time otherwise.
+
+SOAK_DIR=`cd \`dirname $0\` && pwd`
+BUILD_DIR=${SOAK_DIR}/../../build
+
+DEIMOS=${BUILD_DIR}/exe/deimos/x64/deimos
+STUB_HOME=${BUILD_DIR}/jvmstub-home
+LEASETIME=2
+
+usage()
+{
+        echo "Usage: $0 [options]"
+        echo ""
+        echo "Where options include:"
+        echo "    -deimos <path>       deimos executable (default ${DEIMOS})"
+        echo "    -home <directory>    stub JAVA_HOME (default ${STUB_HOME})"
+        echo "    -leasetime <s>       lapse of the lease (default ${LEASETIME})"
+        exit 2
+}
+
+fail()
+{
+        echo "$0: $*" >&2
+        cleanup
+        exit 1
+}
+
+# Current time in milliseconds
+now()
+{
+        expr `date +%s%N` / 1000000
+}
+
+# Process state (R, S, T, Z...) or nothing if it does not exist
+state()
+{
+        awk '{ print $3 }' /proc/$1/stat 2>/dev/null
+}
+
+# Pid of the current child of the instance $1 according to its PID file
+child()
+{
+        head -1 ${WORK}/$1.pid 2>/dev/null
+}
+
+# Last step of the JVM $1
+last_step()
+{
+        awk -v p=$1 '$2 == p && $3 != "check" { s = $3 } END { print s }' ${WORK}/events
+}
+
+# Time of the last step $2 of the JVM $1
+step_time()
+{
+        awk -v p=$1 -v s=$2 '$2 == p && $3 == s { t = $1 } END { print t }' ${WORK}/events
+}
+
+# Add a line to the events file on behalf of the process $1
+note()
+{
+        echo "`now` $1 $2" >> ${WORK}/events
+}
+
+cleanup()
+{
+        for i in a b; do
+                pid=`child ${i}`
+                [ -n "${pid}" ] && kill -CONT ${pid} 2>/dev/null && kill -9 ${pid} 2>/dev/null
+        done
+        [ -n "${CONTROLLER_a}" ] && kill -9 ${CONTROLLER_a} 2>/dev/null
+        [ -n "${CONTROLLER_b}" ] && kill -9 ${CONTROLLER_b} 2>/dev/null
+        wait 2>/dev/null
+        [ -n "${WORK}" ] && rm -rf ${WORK}
+}
+
+# Start the instance $1 and wait for its child to be ready. Sets CHILD.
+start()
+{
+        ${DEIMOS} -nodetach -restartdelay 0 -home ${STUB_HOME} \
+                -pidfile ${WORK}/$1.pid -lease ${WORK}/lease -leasetime ${LEASETIME} \
+                -outfile ${WORK}/$1.out -errfile ${WORK}/$1.err \
+                ${WORK}/lease.jar > /dev/null 2>&1 &
+        eval CONTROLLER_$1=$!
+        limit=`expr \`now\` + ${LAPSE} \* 4`
+        while :; do
+                CHILD=`child $1`
+                [ -n "${CHILD}" ] && [ -f /tmp/${CHILD}.deimos_up ] && return
+                [ `now` -gt ${limit} ] && fail "instance $1 did not start, see ${WORK}/$1.err"
+                sleep 0.01
+        done
+}
+
+# Wait up to $3 ms for the JVM $1 to reach the step $2
+wait_step()
+{
+        limit=`expr \`now\` + $3`
+        while [ "`last_step $1`" != "$2" ]; do
+                [ `now` -gt ${limit} ] && fail "$1 not in $2 after $3 ms (`last_step $1`)"
+                sleep 0.01
+        done
+}
+
+# Check that the JVM $1 stays a standby for a whole lapse
+standby()
+{
+        sleep ${LEASETIME}
+        case `last_step $1` in
+                resume) fail "$1 resumed while another instance holds the lease" ;;
+        esac
+}
+
+# Replay the events: a JVM runs from its resume to its pause, destroy or
+# death, except while it is stopped. Once continued after a stall it may run
+# until it sees the lease is lost, which is timed apart.
+overlap()
+{
+        sort -n -s -k1,1 ${WORK}/events | awk '
+                $3 == "resume" {
+                        for (p in running)
+                                if (running[p] && !stalled[p])
+                                        print $1 " " $2 " resumed while " p " runs"
+                        running[$2] = 1
+                }
+                $3 == "pause" || $3 == "destroy" || $3 == "exit" || $3 == "killed" {
+                        running[$2] = 0; stalled[$2] = 0
+                }
+                $3 == "stopped" { held[$2] = running[$2]; running[$2] = 0 }
+                $3 == "continued" { running[$2] = held[$2]; stalled[$2] = 1 }'
+}
+
+while [ $# -gt 0 ]; do
+        case $1 in
+                -deimos) DEIMOS=$2; shift ;;
+                -home) STUB_HOME=$2; shift ;;
+                -leasetime) LEASETIME=$2; shift ;;
+                *) usage ;;
+        esac
+        shift
+done
+
+[ -x "${DEIMOS}" ] || fail "cannot execute deimos ${DEIMOS}"
+[ -f "${STUB_HOME}/lib/jvm.cfg" ] || fail "no stub JAVA_HOME in ${STUB_HOME}"
+DEIMOS=`cd \`dirname ${DEIMOS}\` && pwd`/`basename ${DEIMOS}`
+LAPSE=`expr ${LEASETIME} \* 1000`
+PERIOD=`expr ${LAPSE} / 4`
+SLACK=500
+
+WORK=`mktemp -d /tmp/deimos-lease.XXXXXX` || fail "cannot create work directory"
+trap 'fail interrupted' INT TERM
+: > ${WORK}/events
+touch ${WORK}/lease.jar
+JVMSTUB="events=${WORK}/events"
+export JVMSTUB
+
+# a holds the lease, b waits for it
+start a
+A=${CHILD}
+wait_step ${A} resume ${LAPSE}
+start b
+B=${CHILD}
+standby ${B}
+
+# Holder killed: the standby takes over at its next check
+T0=`now`
+kill -9 ${CONTROLLER_a} ${A}
+note ${A} killed
+wait ${CONTROLLER_a} 2>/dev/null
+wait_step ${B} resume ${LAPSE}
+TAKEOVER=`expr \`step_time ${B} resume\` - ${T0}`
+echo "kill:     takeover in ${TAKEOVER} ms"
+[ ${TAKEOVER} -le `expr ${PERIOD} + ${SLACK}` ] || fail "dead holder replaced after ${TAKEOVER} ms"
+rm -f ${WORK}/a.pid
+start a
+A=${CHILD}
+standby ${A}
+
+# Holder stalled: the standby waits for the lapse, and the holder pauses as
+# soon as it continues
+T0=`now`
+kill -STOP ${B}
+note ${B} stopped
+wait_step ${A} resume `expr ${LAPSE} + ${PERIOD} + ${SLACK}`
+TAKEOVER=`expr \`step_time ${A} resume\` - ${T0}`
+[ ${TAKEOVER} -ge `expr ${LAPSE} - ${PERIOD}` ] || fail "lease of a stalled holder taken after ${TAKEOVER} ms"
+[ "`state ${B}`" = "T" ] || fail "stalled holder ${B} not stopped"
+T1=`now`
+note ${B} continued
+kill -CONT ${B}
+wait_step ${B} pause `expr ${LAPSE} / 2`
+echo "stall:    takeover in ${TAKEOVER} ms, paused `expr \`step_time ${B} pause\` - ${T1}` ms after SIGCONT"
+standby ${B}
+
+# Holder shut down: it pauses and releases the lease, the standby takes
+# over at its next check
+T0=`now`
+kill -TERM ${CONTROLLER_a}
+wait ${CONTROLLER_a}
+STATUS=$?
+CONTROLLER_a=
+[ ${STATUS} -eq 0 ] || fail "holder exited with ${STATUS}, see ${WORK}/a.err"
+wait_step ${B} resume ${LAPSE}
+TAKEOVER=`expr \`step_time ${B} resume\` - ${T0}`
+echo "shutdown: takeover in ${TAKEOVER} ms"
+[ ${TAKEOVER} -le `expr ${PERIOD} + ${SLACK}` ] || fail "released lease taken after ${TAKEOVER} ms"
+
+kill -TERM ${CONTROLLER_b}
+wait ${CONTROLLER_b}
+STATUS=$?
+CONTROLLER_b=
+[ ${STATUS} -eq 0 ] || fail "standby exited with ${STATUS}, see ${WORK}/b.err"
+
+SPLIT=`overlap`
+[ -z "${SPLIT}" ] || fail "split brain: ${SPLIT}"
+cleanup
+exit 0
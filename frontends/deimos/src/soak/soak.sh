@@ -0,0 +1,331 @@
+#!/bin/sh
+# Licensed to the Apache Software Foundation (ASF) under one or more
+# contributor license agreements.  See the NOTICE file distributed with
+# this work for additional information regarding copyright ownership.
+# The ASF licenses this file to You under the Apache License, Version 2.0
+# (the "License"); you may not use this file except in compliance with
+# the License.  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Soak and chaos test of the deimos controller, running against the stub
+# libjvm (see src/jvmstub).
+#
+# The controller is restarted thousands of times through crashes (SIGKILL,
+# SIGSEGV, abort hook, exit 123), hangs, slow initialize(), signal storms and
+# a stdout pipe drained slower than it is written. After every restart the
+# controller RSS, open file descriptors and zombie children are sampled along
+# with the restart latency. The test fails when one of them trends upward
+# between the beginning and the end of the run, or when readiness files are
+# left behind in /tmp.
+
+SOAK_DIR=`cd \`dirname $0\` && pwd`
+BUILD_DIR=${SOAK_DIR}/../../build
+
+DEIMOS=${BUILD_DIR}/exe/deimos/x64/deimos
+STUB_HOME=${BUILD_DIR}/jvmstub-home
+CYCLES=10000
+SEED=1
+HANG=2000
+LIFE=50
+SLOW=5
+SLOWMS=500
+PIPE=5
+STORM=50
+THRESHOLD=10
+SAMPLES=
+
+usage()
+{
+        echo "Usage: $0 [options]"
+        echo ""
+        echo "Where options include:"
+        echo "    -deimos <path>       deimos executable (default ${DEIMOS})"
+        echo "    -home <directory>    stub JAVA_HOME (default ${STUB_HOME})"
+        echo "    -cycles <n>          number of restarts (default ${CYCLES})"
+        echo "    -seed <n>            seed of the fault selection (default ${SEED})"
+        echo "    -hang <ms>           time after which a starting child is killed (default ${HANG})"
+        echo "    -life <ms>           lifetime of a child nobody killed (default ${LIFE})"
+        echo "    -slow <pct>          starts with a slow initialize() (default ${SLOW})"
+        echo "    -slowms <ms>         duration of a slow initialize() (default ${SLOWMS})"
+        echo "    -pipe <pct>          starts filling the stdout pipe (default ${PIPE})"
+        echo "    -storm <n>           pause/resume signals sent by a storm (default ${STORM})"
+        echo "    -threshold <pct>     tolerated growth of a metric (default ${THRESHOLD})"
+        echo "    -samples <file>      keep the raw samples (cycle rss fds zombies latency)"
+        exit 2
+}
+
+fail()
+{
+        echo "$0: $*" >&2
+        cleanup
+        exit 1
+}
+
+# Current time in milliseconds
+now()
+{
+        expr `date +%s%N` / 1000000
+}
+
+# Pseudo random number in [0, 100)
+random()
+{
+        SEED=`expr \( ${SEED} \* 1103515245 + 12345 \) % 2147483648`
+        RANDOM_VALUE=`expr ${SEED} / 65536 % 100`
+}
+
+# Process state (R, S, Z...) or nothing if it does not exist
+state()
+{
+        awk '{ print $3 }' /proc/$1/stat 2>/dev/null
+}
+
+controller_alive()
+{
+        case `state ${CONTROLLER}` in
+                ""|Z) return 1 ;;
+        esac
+        return 0
+}
+
+# Pid of the current child according to the PID file
+child()
+{
+        head -1 ${WORK}/soak.pid 2>/dev/null
+}
+
+cleanup()
+{
+        [ -n "${CONTROLLER}" ] && kill -9 ${CONTROLLER} 2>/dev/null
+        pid=`child`
+        [ -n "${pid}" ] && kill -9 ${pid} 2>/dev/null
+        [ -n "${READER}" ] && kill ${READER} 2>/dev/null
+        wait 2>/dev/null
+        if [ -n "${WORK}" ]; then
+                [ -n "${SAMPLES}" ] && cp ${WORK}/samples ${SAMPLES}
+                rm -rf ${WORK}
+        fi
+}
+
+# Wait for a new child to be ready, killing the ones which do not start in
+# time. Sets READY to the pid of the child.
+wait_ready()
+{
+        limit=`expr \`now\` + ${HANG}`
+        while :; do
+                pid=`child`
+                if [ -n "${pid}" ] && [ "${pid}" != "${LAST}" ]; then
+                        if [ -f /tmp/${pid}.deimos_up ]; then
+                                READY=${pid}
+                                return
+                        fi
+                        if [ `now` -gt ${limit} ]; then
+                                kill -9 ${pid} 2>/dev/null
+                                echo ${pid} >> ${WORK}/children
+                                HANGS=`expr ${HANGS} + 1`
+                                LAST=${pid}
+                                DEATH=`now`
+                                limit=`expr ${DEATH} + ${HANG}`
+                        fi
+                elif [ `now` -gt ${limit} ]; then
+                        controller_alive || fail "controller died, see ${WORK}/errfile"
+                        limit=`expr \`now\` + ${HANG}`
+                fi
+                sleep 0.005
+        done
+}
+
+# Wait for the death of a child, killing it if it hangs
+wait_death()
+{
+        limit=`expr \`now\` + ${HANG}`
+        while [ -n "`state $1`" ]; do
+                if [ `now` -gt ${limit} ]; then
+                        kill -9 $1 2>/dev/null
+                        HANGS=`expr ${HANGS} + 1`
+                        limit=`expr \`now\` + ${HANG}`
+                fi
+                sleep 0.005
+        done
+        DEATH=`now`
+}
+
+# Take one sample of the controller resources
+sample()
+{
+        rss=`awk '/^VmRSS:/ { print $2 }' /proc/${CONTROLLER}/status`
+        fds=`ls /proc/${CONTROLLER}/fd | wc -l`
+        zombies=`ps -e -o ppid=,stat= | awk -v p=${CONTROLLER} '$1 == p && $2 ~ /^Z/ { n++ } END { print n + 0 }'`
+        echo "$1 ${rss} ${fds} ${zombies} $2" >> ${WORK}/samples
+}
+
+# Kill the ready child one way or another
+inject()
+{
+        random
+        if [ ${RANDOM_VALUE} -lt 20 ]; then
+                CRASHES=`expr ${CRASHES} + 1`
+                kill -9 $1 2>/dev/null
+        elif [ ${RANDOM_VALUE} -lt 30 ]; then
+                CRASHES=`expr ${CRASHES} + 1`
+                kill -SEGV $1 2>/dev/null
+        elif [ ${RANDOM_VALUE} -lt 40 ]; then
+                STORMS=`expr ${STORMS} + 1`
+                n=0
+                while [ ${n} -lt ${STORM} ]; do
+                        kill -USR2 ${CONTROLLER} 2>/dev/null
+                        kill -USR1 ${CONTROLLER} 2>/dev/null
+                        n=`expr ${n} + 2`
+                done
+        fi
+        # Otherwise the child reloads itself after LIFE ms
+}
+
+# Median of the column $2 for the lines $3 to $4 of the file $1
+median()
+{
+        sed -n "$3,$4p" $1 | awk -v c=$2 '{ print $c }' | sort -n | awk '
+                { v[NR] = $1 }
+                END { print NR ? v[int((NR + 1) / 2)] : 0 }'
+}
+
+# Percentile $2 of the column $3 of the file $1
+percentile()
+{
+        awk -v c=$3 '{ print $c }' $1 | sort -n | awk -v p=$2 '
+                { v[NR] = $1 }
+                END { i = int(NR * p / 100 + 0.5); if (i < 1) i = 1; print v[i] }'
+}
+
+# Compare the medians of the first and last windows of a metric and report a
+# leak if it grew by more than THRESHOLD percent plus a slack
+trend()
+{
+        first=`median ${WORK}/samples $2 ${FROM} ${FIRST_END}`
+        last=`median ${WORK}/samples $2 ${LAST_START} ${COUNT}`
+        if awk -v f=${first} -v l=${last} -v t=${THRESHOLD} -v s=$3 \
+                'BEGIN { exit !(l > f * (1 + t / 100) + s) }'; then
+                printf "%-16s %12s %12s  LEAK\n" "$1" ${first} ${last}
+                LEAKS=`expr ${LEAKS} + 1`
+        else
+                printf "%-16s %12s %12s\n" "$1" ${first} ${last}
+        fi
+}
+
+while [ $# -gt 0 ]; do
+        case $1 in
+                -deimos) DEIMOS=$2; shift ;;
+                -home) STUB_HOME=$2; shift ;;
+                -cycles) CYCLES=$2; shift ;;
+                -seed) SEED=$2; shift ;;
+                -hang) HANG=$2; shift ;;
+                -life) LIFE=$2; shift ;;
+                -slow) SLOW=$2; shift ;;
+                -slowms) SLOWMS=$2; shift ;;
+                -pipe) PIPE=$2; shift ;;
+                -storm) STORM=$2; shift ;;
+                -threshold) THRESHOLD=$2; shift ;;
+                -samples) SAMPLES=$2; shift ;;
+                *) usage ;;
+        esac
+        shift
+done
+
+[ -x "${DEIMOS}" ] || fail "cannot execute deimos ${DEIMOS}"
+[ -f "${STUB_HOME}/lib/jvm.cfg" ] || fail "no stub JAVA_HOME in ${STUB_HOME}"
+DEIMOS=`cd \`dirname ${DEIMOS}\` && pwd`/`basename ${DEIMOS}`
+
+WORK=`mktemp -d /tmp/deimos-soak.XXXXXX` || fail "cannot create work directory"
+trap 'fail interrupted' INT TERM
+: > ${WORK}/samples
+: > ${WORK}/children
+touch ${WORK}/soak.jar
+
+# stdout of the children goes to a pipe drained 4 KiB at a time
+mkfifo ${WORK}/stdout
+(while :; do
+        dd bs=4096 count=1 of=/dev/null 2>/dev/null
+        sleep 0.02
+done) < ${WORK}/stdout &
+READER=$!
+
+# Faults injected by the stub itself
+JVMSTUB="load=${SLOW}%delay:${SLOWMS}"
+JVMSTUB="${JVMSTUB};resume=2%crash+2%crash:11+2%abort+2%exit:123+1%hang"
+JVMSTUB="${JVMSTUB}+${PIPE}%print:2000+reload:${LIFE}"
+export JVMSTUB
+
+${DEIMOS} -nodetach -restartdelay 0 -home ${STUB_HOME} \
+        -pidfile ${WORK}/soak.pid -outfile '&1' -errfile ${WORK}/errfile \
+        ${WORK}/soak.jar > ${WORK}/stdout 2>&1 &
+CONTROLLER=$!
+
+CYCLE=0
+LAST=
+HANGS=0
+CRASHES=0
+STORMS=0
+DEATH=`now`
+START=${DEATH}
+while [ ${CYCLE} -lt ${CYCLES} ]; do
+        wait_ready
+        sample ${CYCLE} `expr \`now\` - ${DEATH}`
+        echo ${READY} >> ${WORK}/children
+        LAST=${READY}
+        inject ${READY}
+        wait_death ${READY}
+        CYCLE=`expr ${CYCLE} + 1`
+        if [ `expr ${CYCLE} % 500` -eq 0 ]; then
+                echo "${CYCLE} restarts, `tail -1 ${WORK}/samples | awk '{ print "rss " $2 " kB, " $3 " fds" }'`" >&2
+        fi
+done
+
+# Stop the controller cleanly
+wait_ready
+kill -TERM ${CONTROLLER}
+wait ${CONTROLLER}
+STATUS=$?
+CONTROLLER=
+ELAPSED=`expr \`now\` - ${START}`
+
+# Skip the first 5% of the run, then compare the first and last 10%
+COUNT=`wc -l < ${WORK}/samples`
+FROM=`expr ${COUNT} / 20 + 1`
+WINDOW=`expr ${COUNT} / 10 + 1`
+FIRST_END=`expr ${FROM} + ${WINDOW} - 1`
+LAST_START=`expr ${COUNT} - ${WINDOW} + 1`
+LEAKS=0
+
+echo "restarts:        ${CYCLE} in ${ELAPSED} ms"
+echo "faults:          ${CRASHES} crashes, ${STORMS} signal storms, ${HANGS} hangs killed"
+echo "latency (ms):    p50 `percentile ${WORK}/samples 50 5`" \
+        "p90 `percentile ${WORK}/samples 90 5`" \
+        "p99 `percentile ${WORK}/samples 99 5`" \
+        "max `percentile ${WORK}/samples 100 5`"
+echo ""
+printf "%-16s %12s %12s\n" "metric" "first" "last"
+trend "rss (kB)" 2 64
+trend "fds" 3 0
+trend "zombies" 4 0
+trend "latency (ms)" 5 20
+
+STALE=0
+for pid in `sort -u ${WORK}/children`; do
+        [ -f /tmp/${pid}.deimos_up ] && STALE=`expr ${STALE} + 1` && rm -f /tmp/${pid}.deimos_up
+done
+if [ ${STALE} -gt 0 ]; then
+        echo "${STALE} readiness files left in /tmp  LEAK"
+        LEAKS=`expr ${LEAKS} + 1`
+fi
+[ ${STATUS} -eq 0 ] || fail "controller exited with ${STATUS}, see ${WORK}/errfile"
+
+cleanup
+[ ${LEAKS} -eq 0 ] || exit 1
+exit 0
@@ -0,0 +1,131 @@
+#!/bin/sh
+# Licensed to the Apache Software Foundation (ASF) under one or more
+# contributor license agreements.  See the NOTICE file distributed with
+# this work for additional information regarding copyright ownership.
+# The ASF licenses this file to You under the Apache License, Version 2.0
+# (the "License"); you may not use this file except in compliance with
+# the License.  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Record and replay test of -workingset, running against the stub libjvm
+# (see src/jvmstub).
+#
+# The child keeps a sparse file open as its -outfile: one page out of two is
+# written, the holes are never in the page cache. The first start records
+# one extent per written page, far more than fit on a line of any fixed
+# buffer. The test fails unless every extent is recorded, and replayed by
+# the next start.
+
+SOAK_DIR=`cd \`dirname $0\` && pwd`
+BUILD_DIR=${SOAK_DIR}/../../build
+
+DEIMOS=${BUILD_DIR}/exe/deimos/x64/deimos
+STUB_HOME=${BUILD_DIR}/jvmstub-home
+EXTENTS=3000
+HANG=5000
+
+usage()
+{
+        echo "Usage: $0 [options]"
+        echo ""
+        echo "Where options include:"
+        echo "    -deimos <path>       deimos executable (default ${DEIMOS})"
+        echo "    -home <directory>    stub JAVA_HOME (default ${STUB_HOME})"
+        echo "    -extents <n>         resident extents of the sparse file (default ${EXTENTS})"
+        exit 2
+}
+
+fail()
+{
+        echo "$0: $*" >&2
+        cleanup
+        exit 1
+}
+
+# Current time in milliseconds
+now()
+{
+        expr `date +%s%N` / 1000000
+}
+
+cleanup()
+{
+        [ -n "${CONTROLLER}" ] && kill -9 ${CONTROLLER} 2>/dev/null
+        pid=`head -1 ${WORK}/ws.pid 2>/dev/null`
+        [ -n "${pid}" ] && kill -9 ${pid} 2>/dev/null
+        wait 2>/dev/null
+        [ -n "${WORK}" ] && rm -rf ${WORK}
+}
+
+# Start deimos with the working set, and stop it once the child is ready
+# and the working set file exists
+run()
+{
+        ${DEIMOS} -nodetach -debug -home ${STUB_HOME} -pidfile ${WORK}/ws.pid \
+                -workingset ${WORK}/set -outfile ${WORK}/sparse -errfile ${WORK}/$1 \
+                ${WORK}/ws.jar > /dev/null 2>&1 &
+        CONTROLLER=$!
+        limit=`expr \`now\` + ${HANG}`
+        while :; do
+                pid=`head -1 ${WORK}/ws.pid 2>/dev/null`
+                [ -n "${pid}" ] && [ -f /tmp/${pid}.deimos_up ] && [ -f ${WORK}/set ] && break
+                [ `now` -gt ${limit} ] && fail "no working set recorded, see ${WORK}/$1"
+                sleep 0.01
+        done
+        kill -TERM ${CONTROLLER}
+        wait ${CONTROLLER}
+        STATUS=$?
+        CONTROLLER=
+        [ ${STATUS} -eq 0 ] || fail "deimos exited with ${STATUS}, see ${WORK}/$1"
+}
+
+while [ $# -gt 0 ]; do
+        case $1 in
+                -deimos) DEIMOS=$2; shift ;;
+                -home) STUB_HOME=$2; shift ;;
+                -extents) EXTENTS=$2; shift ;;
+                *) usage ;;
+        esac
+        shift
+done
+
+[ -x "${DEIMOS}" ] || fail "cannot execute deimos ${DEIMOS}"
+[ -f "${STUB_HOME}/lib/jvm.cfg" ] || fail "no stub JAVA_HOME in ${STUB_HOME}"
+DEIMOS=`cd \`dirname ${DEIMOS}\` && pwd`/`basename ${DEIMOS}`
+PAGE=`getconf PAGESIZE`
+
+WORK=`mktemp -d /tmp/deimos-ws.XXXXXX` || fail "cannot create work directory"
+trap 'fail interrupted' INT TERM
+touch ${WORK}/ws.jar
+
+# Pages 0, 2, 4... written, 1, 3, 5... left as holes
+n=0
+while [ ${n} -lt ${EXTENTS} ]; do
+        dd if=/dev/zero of=${WORK}/sparse bs=${PAGE} count=1 seek=`expr ${n} \* 2` \
+                conv=notrunc 2>/dev/null || fail "cannot write ${WORK}/sparse"
+        n=`expr ${n} + 1`
+done
+
+# First start: records the working set
+run record.log
+RECORDED=`awk -F '\t' -v f=${WORK}/sparse '$2 == f { n += split($1, e, ",") } END { print n + 0 }' ${WORK}/set`
+LINES=`awk -F '\t' -v f=${WORK}/sparse '$2 == f { n++ } END { print n + 0 }' ${WORK}/set`
+LONGEST=`awk '{ if (length($0) > l) l = length($0) } END { print l + 0 }' ${WORK}/set`
+echo "recorded: ${RECORDED} extents on ${LINES} lines of ${LONGEST} bytes at most"
+[ ${RECORDED} -eq ${EXTENTS} ] || fail "${RECORDED} extents of ${EXTENTS} recorded"
+
+# Second start: replays it
+run replay.log
+grep "Readahead of ${WORK}/sparse (.* ${EXTENTS} extents)" ${WORK}/replay.log > /dev/null ||
+        fail "extents of ${WORK}/sparse not all replayed, see ${WORK}/replay.log"
+echo "replayed: ${EXTENTS} extents"
+
+cleanup
+exit 0
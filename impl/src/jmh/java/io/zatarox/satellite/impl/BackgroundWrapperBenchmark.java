@@ -0,0 +1,92 @@
+/*
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+package io.zatarox.satellite.impl;
+
+import io.zatarox.satellite.*;
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.util.concurrent.TimeUnit;
+import java.util.jar.Attributes;
+import java.util.jar.JarOutputStream;
+import java.util.jar.Manifest;
+import org.openjdk.jmh.annotations.*;
+
+/**
+ * Cost of BackgroundWrapper.load() depending on the number of entries of the
+ * manifest Class-Path attribute.
+ */
+@BenchmarkMode(Mode.AverageTime)
+@OutputTimeUnit(TimeUnit.MICROSECONDS)
+@State(Scope.Benchmark)
+public class BackgroundWrapperBenchmark {
+
+    @Param({"10", "100", "500", "2000"})
+    public int classPath;
+
+    private File jar;
+
+    @Setup
+    public void setUp() throws IOException {
+        final Manifest manifest = new Manifest();
+        manifest.getMainAttributes().put(Attributes.Name.MANIFEST_VERSION, "1.0");
+        manifest.getMainAttributes().putValue("Background-Process-Class", NoopProcess.class.getName());
+        final StringBuilder paths = new StringBuilder();
+        for (int i = 0; i < classPath; i++) {
+            paths.append("lib/dependency-").append(i).append(".jar ");
+        }
+        manifest.getMainAttributes().put(Attributes.Name.CLASS_PATH, paths.toString().trim());
+        jar = File.createTempFile("benchmark", ".jar");
+        jar.deleteOnExit();
+        new JarOutputStream(new FileOutputStream(jar), manifest).close();
+    }
+
+    @TearDown
+    public void tearDown() {
+        jar.delete();
+    }
+
+    @Benchmark
+    public boolean load() {
+        return new BackgroundWrapper(getClass().getClassLoader()).load(jar.getPath(), null);
+    }
+
+    public static final class NoopProcess implements BackgroundProcess {
+
+        @Override
+        public void initialize(BackgroundContext context) throws BackgroundException, Exception {
+        }
+
+        @Override
+        public void resume() throws Exception {
+        }
+
+        @Override
+        public void pause() throws Exception {
+        }
+
+        @Override
+        public void shutdown() {
+        }
+    }
+
+}
@@ -0,0 +1,90 @@
+/*
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+package io.zatarox.satellite.impl;
+
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.util.concurrent.TimeUnit;
+import java.util.jar.Attributes;
+import java.util.jar.JarOutputStream;
+import java.util.jar.Manifest;
+import org.openjdk.jmh.annotations.*;
+
+/**
+ * Cost of the controller state transitions driven by resume() and pause(),
+ * alone and under contention.
+ */
+@BenchmarkMode(Mode.Throughput)
+@OutputTimeUnit(TimeUnit.MICROSECONDS)
+public class ControllerBenchmark {
+
+    @State(Scope.Group)
+    public static class Wrapper {
+
+        private BackgroundWrapper wrapper;
+        private File jar;
+
+        @Setup
+        public void setUp() throws IOException {
+            final Manifest manifest = new Manifest();
+            manifest.getMainAttributes().put(Attributes.Name.MANIFEST_VERSION, "1.0");
+            manifest.getMainAttributes().putValue("Background-Process-Class",
+                    BackgroundWrapperBenchmark.NoopProcess.class.getName());
+            jar = File.createTempFile("benchmark", ".jar");
+            jar.deleteOnExit();
+            new JarOutputStream(new FileOutputStream(jar), manifest).close();
+            wrapper = new BackgroundWrapper(getClass().getClassLoader());
+            if (!wrapper.load(jar.getPath(), null)) {
+                throw new IllegalStateException("Cannot load " + jar);
+            }
+        }
+
+        @TearDown
+        public void tearDown() {
+            wrapper.shutdown();
+            jar.delete();
+        }
+    }
+
+    @Benchmark
+    @Group("uncontended")
+    @GroupThreads(1)
+    public boolean transition(Wrapper state) {
+        return state.wrapper.resume() & state.wrapper.pause();
+    }
+
+    @Benchmark
+    @Group("contended")
+    @GroupThreads(2)
+    public boolean resume(Wrapper state) {
+        return state.wrapper.resume();
+    }
+
+    @Benchmark
+    @Group("contended")
+    @GroupThreads(2)
+    public boolean pause(Wrapper state) {
+        return state.wrapper.pause();
+    }
+
+}
@@ -0,0 +1,123 @@
+/*
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+package io.zatarox.satellite.impl;
+
+import java.io.ByteArrayOutputStream;
+import java.io.DataOutputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.util.concurrent.TimeUnit;
+import java.util.jar.JarEntry;
+import java.util.jar.JarOutputStream;
+import org.openjdk.jmh.annotations.*;
+
+/**
+ * Class and resource lookup throughput of the embedded class loader against
+ * embedded jars of various sizes.
+ */
+@BenchmarkMode(Mode.Throughput)
+@OutputTimeUnit(TimeUnit.MILLISECONDS)
+@State(Scope.Benchmark)
+public class EmbeddedClassLoaderBenchmark {
+
+    /* Not on the class path, so that it is only found in the embedded jar */
+    private static final String PAYLOAD = "io.zatarox.satellite.benchmark.Payload";
+
+    /** Number of resources stored before the looked up entries. */
+    @Param({"10", "100", "1000"})
+    public int entries;
+
+    private EmbeddedClassLoader loader;
+    private byte[] content;
+
+    @Setup
+    public void setUp() throws IOException {
+        final ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        final JarOutputStream jar = new JarOutputStream(baos);
+        final byte[] resource = new byte[1024];
+        for (int i = 0; i < entries; i++) {
+            jar.putNextEntry(new JarEntry("io/zatarox/satellite/resources/resource" + i + ".bin"));
+            jar.write(resource);
+            jar.closeEntry();
+        }
+        jar.putNextEntry(new JarEntry(PAYLOAD.replace('.', '/') + ".class"));
+        jar.write(payload());
+        jar.closeEntry();
+        jar.close();
+        content = baos.toByteArray();
+        loader = new EmbeddedClassLoader(content);
+    }
+
+    @Benchmark
+    public InputStream firstResource() {
+        return loader.getResourceAsStream("io/zatarox/satellite/resources/resource0.bin");
+    }
+
+    @Benchmark
+    public InputStream lastResource() {
+        return loader.getResourceAsStream("io/zatarox/satellite/resources/resource" + (entries - 1) + ".bin");
+    }
+
+    @Benchmark
+    public InputStream missingResource() {
+        return loader.getResourceAsStream("io/zatarox/satellite/resources/missing.bin");
+    }
+
+    @Benchmark
+    public Class<?> findClass() throws ClassNotFoundException {
+        /* A class can be defined once per loader */
+        return new EmbeddedClassLoader(content).findClass(PAYLOAD);
+    }
+
+    @Benchmark
+    public Class<?> loadSystemClass() throws ClassNotFoundException {
+        return loader.loadClass("java.util.ArrayList");
+    }
+
+    /* Bytecode of an empty public class named PAYLOAD */
+    private static byte[] payload() throws IOException {
+        final ByteArrayOutputStream baos = new ByteArrayOutputStream();
+        final DataOutputStream out = new DataOutputStream(baos);
+        out.writeInt(0xCAFEBABE);
+        out.writeShort(0);
+        out.writeShort(50);
+        out.writeShort(5);
+        out.writeByte(7);
+        out.writeShort(2);
+        out.writeByte(1);
+        out.writeUTF(PAYLOAD.replace('.', '/'));
+        out.writeByte(7);
+        out.writeShort(4);
+        out.writeByte(1);
+        out.writeUTF("java/lang/Object");
+        out.writeShort(0x0021);
+        out.writeShort(1);
+        out.writeShort(3);
+        out.writeShort(0);
+        out.writeShort(0);
+        out.writeShort(0);
+        out.writeShort(0);
+        out.close();
+        return baos.toByteArray();
+    }
+
+}
@@ -16,13 +16,20 @@
 package io.zatarox.satellite.impl;
 
 import io.zatarox.satellite.BackgroundException;
+import java.io.Closeable;
 import java.io.File;
 import java.io.IOException;
+import java.lang.ref.Reference;
+import java.lang.ref.WeakReference;
 import java.lang.reflect.InvocationTargetException;
 import java.net.URL;
 import java.net.URLClassLoader;
+import java.nio.channels.ServerSocketChannel;
+import java.util.Collections;
+import java.util.LinkedHashMap;
 import java.util.LinkedList;
 import java.util.List;
+import java.util.Map;
 import java.util.jar.Manifest;
 import java.util.zip.ZipFile;
 import io.zatarox.satellite.*;
@@ -32,9 +39,19 @@ import io.zatarox.satellite.*;
  */
 public final class BackgroundWrapper {
     
+    /* Garbage collections waited for the class loader of a reloaded process */
+    private static final int RELOAD_COLLECTIONS = 10;
+    private static final long RELOAD_COLLECTION_DELAY = 100;
+
     private Controller controller = null;
     private Object instance = null;
     private final ClassLoader loader;
+    private URLClassLoader processLoader = null;
+    private String jarName = null;
+    private String[] args = null;
+    private Map<String, ServerSocketChannel> listeners = Collections.emptyMap();
+    private Map<String, ServerSocketChannel> loaded = Collections.emptyMap();
+    private Hibernation hibernation = null;
     
     public BackgroundWrapper(ClassLoader loader) {
         if (loader == null)
@@ -68,6 +85,23 @@ public final class BackgroundWrapper {
         return true;
     }
 
+    /**
+     * Set the listening sockets inherited from the launcher, given to the
+     * BackgroundContext of the next loads. The launcher gives every reload
+     * channels of its own, the ones of the previous load are closed once it
+     * is shut down.
+     *
+     * @param names Names of the sockets
+     * @param channels Channels of the sockets, in the same order
+     */
+    public void listen(final String[] names, final ServerSocketChannel[] channels) {
+        final Map<String, ServerSocketChannel> map = new LinkedHashMap<String, ServerSocketChannel>();
+        for (int i = 0; i < names.length; i++) {
+            map.put(names[i], channels[i]);
+        }
+        listeners = Collections.unmodifiableMap(map);
+    }
+
     /**
      * Load the BackgroundProcess class entry-point.
      *
@@ -83,6 +117,8 @@ public final class BackgroundWrapper {
                 throw new IllegalArgumentException("No main jar provided");
             }
 
+            this.jarName = jarName;
+            this.args = args;
             controller = new Controller();
             /* Set the availability flag in the controller */
             controller.setAvailable(false);
@@ -90,6 +126,8 @@ public final class BackgroundWrapper {
             final Context context = new Context();
             context.setArguments(args != null ? args : new String[0]);
             context.setController(controller);
+            context.setListeners(listeners);
+            loaded = listeners;
             
             final File jar = new File(jarName);
             final ZipFile archive = new ZipFile(jar);
@@ -111,8 +149,8 @@ public final class BackgroundWrapper {
                 }
             }
             
-            final URLClassLoader loader = new URLClassLoader(urls.toArray(new URL[0]), this.loader);
-            final Class<?> c = Class.forName(manifest.getMainAttributes().getValue("Background-Process-Class"), true, loader);
+            processLoader = new URLClassLoader(urls.toArray(new URL[0]), this.loader);
+            final Class<?> c = Class.forName(manifest.getMainAttributes().getValue("Background-Process-Class"), true, processLoader);
             instance = c.newInstance();
             ((BackgroundProcess) instance).initialize(context);
             result = true;
@@ -136,6 +174,11 @@ public final class BackgroundWrapper {
     
     public boolean resume() {
         try {
+            /* Let the heap grow again */
+            if (hibernation != null) {
+                hibernation.restore();
+                hibernation = null;
+            }
             /* Attempt to resume the background process */
             if(instance != null)
                 ((BackgroundProcess) instance).resume();
@@ -170,6 +213,23 @@ public final class BackgroundWrapper {
         return true;
     }
     
+    /**
+     * Pause the BackgroundProcess, then give its free heap back to the
+     * system until it is resumed.
+     *
+     * @return true if paused.
+     */
+    public boolean hibernate() {
+        if (!pause()) {
+            return false;
+        }
+        if (hibernation == null) {
+            hibernation = new Hibernation();
+            hibernation.shrink();
+        }
+        return true;
+    }
+    
     public boolean shutdown() {
         try {
             /* Attempt to shutdown the background process */
@@ -187,6 +247,67 @@ public final class BackgroundWrapper {
         return true;
     }
     
+    /**
+     * Reload the BackgroundProcess in this JVM: shut it down, close its class
+     * loader, then load the jar again (manifest included) in a fresh one and
+     * initialize it. The caller resumes it afterwards.
+     *
+     * @return true if reloaded, false if the old class loader is still
+     * reachable (or the reload failed) and the JVM must be restarted.
+     */
+    public boolean reload() {
+        if (jarName == null || !shutdown()) {
+            return false;
+        }
+        /* Each channel wraps a descriptor of its own: the sockets stay open */
+        if (loaded != listeners) {
+            for (ServerSocketChannel channel : loaded.values()) {
+                try {
+                    channel.close();
+                } catch (IOException ex) {
+                }
+            }
+            loaded = listeners;
+        }
+        final Reference<ClassLoader> previous = new WeakReference<ClassLoader>(processLoader);
+        try {
+            /* URLClassLoader is Closeable since Java 7 */
+            if (processLoader instanceof Closeable) {
+                ((Closeable) processLoader).close();
+            }
+        } catch (IOException ex) {
+        }
+        processLoader = null;
+
+        /* Threads, static caches or shutdown hooks of the process keeping its
+         * classes alive would leak them on every reload */
+        if (!collected(previous, RELOAD_COLLECTIONS, RELOAD_COLLECTION_DELAY)) {
+            return false;
+        }
+        return load(jarName, args);
+    }
+
+    /**
+     * Wait for an object to be garbage collected.
+     *
+     * @param reference Weak reference to the object
+     * @param collections Maximum number of garbage collections to request
+     * @param delay Milliseconds waited after each collection
+     * @return true if the object was collected.
+     */
+    static boolean collected(Reference<?> reference, int collections, long delay) {
+        for (int i = 0; i < collections && reference.get() != null; i++) {
+            System.gc();
+            try {
+                Thread.sleep(delay);
+            } catch (InterruptedException ex) {
+                Thread.currentThread().interrupt();
+                break;
+            }
+        }
+        return reference.get() == null;
+    }
+
     private native void shutdown(boolean reload);
     
     private native void failed(String message);
@@ -245,6 +366,8 @@ public final class BackgroundWrapper {
         
         private String[] args = null;
 
+        private Map<String, ServerSocketChannel> listeners = null;
+
         private Context() {
         }
         
@@ -263,5 +386,13 @@ public final class BackgroundWrapper {
         public void setArguments(String[] args) {
             this.args = args;
         }
+        
+        public Map<String, ServerSocketChannel> getListeners() {
+            return listeners;
+        }
+        
+        public void setListeners(Map<String, ServerSocketChannel> listeners) {
+            this.listeners = listeners;
+        }
     }
 }
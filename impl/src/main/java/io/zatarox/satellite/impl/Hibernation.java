@@ -0,0 +1,87 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package io.zatarox.satellite.impl;
+
+import com.sun.management.HotSpotDiagnosticMXBean;
+import java.lang.management.ManagementFactory;
+import java.lang.management.MemoryUsage;
+import java.util.LinkedList;
+
+/**
+ * Give the heap of a paused process back to the system: the free heap
+ * ratios are lowered and a full collection shrinks the heap (G1, Parallel
+ * and Serial), and SoftMaxHeapSize lets ZGC and Shenandoah uncommit it. The
+ * flags are all manageable ones, the options a JVM does not know (or does
+ * not let change) are skipped.
+ */
+final class Hibernation {
+
+    /* Free heap percentage kept after a collection while hibernating */
+    private static final String MAX_FREE_RATIO = "10";
+
+    private final HotSpotDiagnosticMXBean diagnostic;
+    /* Option names and values to restore, last set first */
+    private final LinkedList<String[]> saved = new LinkedList<String[]>();
+
+    Hibernation() {
+        HotSpotDiagnosticMXBean bean = null;
+        try {
+            bean = ManagementFactory.getPlatformMXBean(HotSpotDiagnosticMXBean.class);
+        } catch (Throwable ex) {
+            /* Not a HotSpot JVM */
+        }
+        diagnostic = bean;
+    }
+
+    /**
+     * Shrink the heap.
+     */
+    void shrink() {
+        /* MinHeapFreeRatio can never exceed MaxHeapFreeRatio */
+        set("MinHeapFreeRatio", "0");
+        set("MaxHeapFreeRatio", MAX_FREE_RATIO);
+        System.gc();
+        final MemoryUsage heap = ManagementFactory.getMemoryMXBean().getHeapMemoryUsage();
+        set("SoftMaxHeapSize", String.valueOf(Math.max(heap.getInit(), heap.getUsed())));
+    }
+
+    /**
+     * Restore the options changed by shrink().
+     */
+    void restore() {
+        while (!saved.isEmpty()) {
+            final String[] option = saved.removeFirst();
+            try {
+                diagnostic.setVMOption(option[0], option[1]);
+            } catch (RuntimeException ex) {
+            }
+        }
+    }
+
+    private void set(String name, String value) {
+        if (diagnostic == null) {
+            return;
+        }
+        try {
+            final String previous = diagnostic.getVMOption(name).getValue();
+            diagnostic.setVMOption(name, value);
+            saved.addFirst(new String[] { name, previous });
+        } catch (RuntimeException ex) {
+            /* Unknown or not manageable in this JVM */
+        }
+    }
+
+}
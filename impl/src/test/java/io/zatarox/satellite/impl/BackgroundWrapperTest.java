@@ -23,51 +23,134 @@ package io.zatarox.satellite.impl;
 
 import io.zatarox.satellite.*;
 import java.io.File;
+import java.io.FileInputStream;
 import java.io.FileOutputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.lang.ref.Reference;
+import java.lang.ref.WeakReference;
+import java.nio.channels.ServerSocketChannel;
+import java.nio.file.Files;
+import java.util.Map;
 import java.util.jar.Attributes;
 import java.util.jar.Manifest;
+import javax.tools.JavaCompiler;
+import javax.tools.ToolProvider;
 import org.apache.commons.compress.archivers.ArchiveOutputStream;
 import org.apache.commons.compress.archivers.ArchiveStreamFactory;
 import org.apache.commons.compress.archivers.zip.ZipArchiveEntry;
+import org.apache.commons.compress.utils.IOUtils;
+import org.apache.commons.io.FileUtils;
 import org.junit.*;
 import static org.junit.Assert.*;
+import static org.junit.Assume.*;
 import org.junit.runner.RunWith;
+import org.powermock.core.classloader.annotations.PowerMockIgnore;
 import org.powermock.core.classloader.annotations.PrepareForTest;
 import org.powermock.modules.junit4.PowerMockRunner;
+import org.powermock.reflect.Whitebox;
 
 @RunWith(PowerMockRunner.class)
 @PrepareForTest(BackgroundWrapper.class)
+@PowerMockIgnore("javax.tools.*")
 public final class BackgroundWrapperTest {
 
+    /* Process of the reload tests, pinning itself in the system properties
+     * under the key given as its first argument */
+    private static final String RELOADED = "reload.ReloadedProcess";
+    private static final String RELOADED_SOURCE =
+            "package reload;\n"
+            + "public final class ReloadedProcess implements io.zatarox.satellite.BackgroundProcess {\n"
+            + "    public void initialize(io.zatarox.satellite.BackgroundContext context) {\n"
+            + "        if (context.getArguments().length > 0)\n"
+            + "            System.getProperties().put(context.getArguments()[0], this);\n"
+            + "    }\n"
+            + "    public void resume() {}\n"
+            + "    public void pause() {}\n"
+            + "    public void shutdown() {}\n"
+            + "}\n";
+    private static final String PIN = "satellite.test.pinned";
+
     private BackgroundWrapper instance;
     private static File file;
+    private static File classes;
+    private static File reloadable;
     private static boolean raiseException;
+    private static boolean closeListeners;
+    private static int initialized;
+    private static int shutdown;
+    private static Map<String, ServerSocketChannel> listeners;
 
     @BeforeClass
     public static void setBefore() throws Exception {
         file = File.createTempFile("archive", ".jar");
         file.deleteOnExit();
-        final FileOutputStream out = new FileOutputStream(file);
+        archive(file, FakeBackgroundProcessImpl.class.getName(), null);
+
+        /* Compiled out of reach of the parent class loader, like the classes
+         * of a deployed jar. A JRE has no compiler: the reload tests are
+         * skipped */
+        final JavaCompiler compiler = ToolProvider.getSystemJavaCompiler();
+        if (compiler != null) {
+            classes = Files.createTempDirectory("reloadable").toFile();
+            final File source = new File(classes, "ReloadedProcess.java");
+            FileUtils.writeStringToFile(source, RELOADED_SOURCE, "UTF-8");
+            assertEquals(0, compiler.run(null, null, null, "-d", classes.getPath(),
+                    "-classpath", System.getProperty("java.class.path"), source.getPath()));
+            reloadable = new File(classes, "reloadable.jar");
+            archive(reloadable, RELOADED, "reload/ReloadedProcess.class");
+        }
+    }
+
+    /* Jar of a process class, and of its class file found in classes */
+    private static void archive(File jar, String process, String clazz) throws Exception {
+        final FileOutputStream out = new FileOutputStream(jar);
         ArchiveOutputStream archive = new ArchiveStreamFactory().createArchiveOutputStream(ArchiveStreamFactory.ZIP, out);
         ZipArchiveEntry entry = new ZipArchiveEntry("META-INF/MANIFEST.MF");
         archive.putArchiveEntry(entry);
         final Manifest manifest = new Manifest();
         manifest.getMainAttributes().put(Attributes.Name.MANIFEST_VERSION, "1.0");
-        manifest.getMainAttributes().putValue("Background-Process-Class", FakeBackgroundProcessImpl.class.getName());
+        manifest.getMainAttributes().putValue("Background-Process-Class", process);
         manifest.write(archive);
         archive.closeArchiveEntry();
+        if (clazz != null) {
+            archive.putArchiveEntry(new ZipArchiveEntry(clazz));
+            final InputStream in = new FileInputStream(new File(classes, clazz));
+            try {
+                IOUtils.copy(in, archive);
+            } finally {
+                in.close();
+            }
+            archive.closeArchiveEntry();
+        }
         archive.close();
     }
 
     @AfterClass
-    public static void setAfter() {
+    public static void setAfter() throws Exception {
         file.delete();
+        if (classes != null) {
+            FileUtils.deleteDirectory(classes);
+        }
+    }
+
+    /* Weak references only: a strong one in the test would pin the loader */
+    private Reference<Class<?>> processClass() {
+        final Object process = Whitebox.getInternalState(instance, "instance");
+        return new WeakReference<Class<?>>(process.getClass());
+    }
+
+    private Reference<ClassLoader> processLoader() {
+        return new WeakReference<ClassLoader>((ClassLoader) Whitebox.getInternalState(instance, "processLoader"));
     }
 
     @Before
     public void setUp() {
         instance = new BackgroundWrapper(BackgroundWrapper.class.getClassLoader());
         raiseException = false;
+        closeListeners = false;
+        initialized = 0;
+        shutdown = 0;
         assertTrue(instance.load(file.getPath(), null));
     }
 
@@ -99,11 +182,138 @@ public final class BackgroundWrapperTest {
         assertTrue(instance.pause());
     }
 
+    @Test
+    public void hibernate() {
+        assertTrue(instance.resume());
+        assertTrue(instance.hibernate());
+        assertTrue(instance.hibernate());
+        assertTrue(instance.resume());
+    }
+
     @Test
     public void destroy() {
         assertTrue(instance.shutdown());
     }
 
+    @Test
+    public void reload() {
+        assertTrue(instance.resume());
+        assertTrue(instance.pause());
+        assertTrue(instance.reload());
+        assertEquals(2, initialized);
+        assertEquals(1, shutdown);
+        assertTrue(instance.resume());
+    }
+
+    @Test
+    public void reloadFreshClass() {
+        assumeNotNull(reloadable);
+        assertTrue(instance.load(reloadable.getPath(), null));
+        final Reference<Class<?>> previous = processClass();
+        final Reference<ClassLoader> previousLoader = processLoader();
+        assertEquals(RELOADED, previous.get().getName());
+        assertNotSame(BackgroundWrapper.class.getClassLoader(), previousLoader.get());
+        assertTrue(instance.resume());
+        assertTrue(instance.pause());
+        assertTrue(instance.reload());
+        /* Collected before the new class is loaded */
+        assertNull(previousLoader.get());
+        assertNull(previous.get());
+        final Class<?> reloaded = Whitebox.getInternalState(instance, "instance").getClass();
+        assertEquals(RELOADED, reloaded.getName());
+        assertSame(Whitebox.getInternalState(instance, "processLoader"), reloaded.getClassLoader());
+        assertTrue(instance.resume());
+    }
+
+    @Test
+    public void reloadPinnedLoader() {
+        assumeNotNull(reloadable);
+        try {
+            assertTrue(instance.load(reloadable.getPath(), new String[] { PIN }));
+            final Reference<ClassLoader> previous = processLoader();
+            assertTrue(instance.resume());
+            assertTrue(instance.pause());
+            /* A static reference keeps the old classes: the JVM must restart */
+            assertFalse(instance.reload());
+            assertNotNull(previous.get());
+            assertNull(Whitebox.getInternalState(instance, "instance"));
+        } finally {
+            System.getProperties().remove(PIN);
+        }
+    }
+
+    @Test
+    public void reloadNotLoaded() {
+        instance = new BackgroundWrapper(BackgroundWrapper.class.getClassLoader());
+        assertFalse(instance.reload());
+    }
+
+    @Test
+    public void collected() {
+        Object leaked = new Object();
+        final WeakReference<Object> reference = new WeakReference<Object>(leaked);
+        assertFalse(BackgroundWrapper.collected(reference, 2, 1));
+        assertNotNull(leaked);
+        leaked = null;
+        assertTrue(BackgroundWrapper.collected(reference, 10, 10));
+    }
+
+    @Test
+    public void listen() throws Exception {
+        assertTrue(listeners.isEmpty());
+        final ServerSocketChannel channel = ServerSocketChannel.open();
+        try {
+            instance.listen(new String[] { "http" }, new ServerSocketChannel[] { channel });
+            assertTrue(instance.load(file.getPath(), null));
+            assertSame(channel, listeners.get("http"));
+            /* The channels survive the reloads */
+            assertTrue(instance.reload());
+            assertSame(channel, listeners.get("http"));
+            assertTrue(channel.isOpen());
+        } finally {
+            channel.close();
+        }
+    }
+
+    @Test
+    public void listenReload() throws Exception {
+        final ServerSocketChannel channel = ServerSocketChannel.open();
+        final ServerSocketChannel fresh = ServerSocketChannel.open();
+        try {
+            closeListeners = true;
+            instance.listen(new String[] { "http" }, new ServerSocketChannel[] { channel });
+            assertTrue(instance.load(file.getPath(), null));
+            /* The launcher hands channels of its own to every reload */
+            instance.listen(new String[] { "http" }, new ServerSocketChannel[] { fresh });
+            assertTrue(instance.reload());
+            assertFalse(channel.isOpen());
+            assertSame(fresh, listeners.get("http"));
+            assertTrue(fresh.isOpen());
+        } finally {
+            channel.close();
+            fresh.close();
+        }
+    }
+
+    @Test
+    public void listenReloadClosed() throws Exception {
+        final ServerSocketChannel channel = ServerSocketChannel.open();
+        final ServerSocketChannel fresh = ServerSocketChannel.open();
+        try {
+            instance.listen(new String[] { "http" }, new ServerSocketChannel[] { channel });
+            assertTrue(instance.load(file.getPath(), null));
+            instance.listen(new String[] { "http" }, new ServerSocketChannel[] { fresh });
+            /* Left open by the process, closed with its generation */
+            assertTrue(instance.reload());
+            assertFalse(channel.isOpen());
+            assertSame(fresh, listeners.get("http"));
+            assertTrue(fresh.isOpen());
+        } finally {
+            channel.close();
+            fresh.close();
+        }
+    }
+
     @Test(expected = UnsupportedOperationException.class)
     public void exception() {
         raiseException = true;
@@ -118,6 +328,8 @@ public final class BackgroundWrapperTest {
             if (raiseException) {
                 throw new BackgroundException("Test", new IllegalArgumentException("tester"));
             }
+            initialized++;
+            listeners = context.getListeners();
         }
 
         @Override
@@ -130,6 +342,15 @@ public final class BackgroundWrapperTest {
 
         @Override
         public void shutdown() {
+            shutdown++;
+            if (closeListeners) {
+                for (ServerSocketChannel channel : listeners.values()) {
+                    try {
+                        channel.close();
+                    } catch (IOException ex) {
+                    }
+                }
+            }
         }
     }
 
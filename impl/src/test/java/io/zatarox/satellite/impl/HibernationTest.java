@@ -0,0 +1,62 @@
+/*
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+package io.zatarox.satellite.impl;
+
+import com.sun.management.HotSpotDiagnosticMXBean;
+import java.lang.management.ManagementFactory;
+import org.junit.Before;
+import org.junit.Test;
+import static org.junit.Assert.*;
+
+public final class HibernationTest {
+
+    private HotSpotDiagnosticMXBean diagnostic;
+
+    @Before
+    public void setUp() {
+        diagnostic = ManagementFactory.getPlatformMXBean(HotSpotDiagnosticMXBean.class);
+    }
+
+    @Test
+    public void shrinkAndRestore() {
+        final String min = diagnostic.getVMOption("MinHeapFreeRatio").getValue();
+        final String max = diagnostic.getVMOption("MaxHeapFreeRatio").getValue();
+        final Hibernation hibernation = new Hibernation();
+        hibernation.shrink();
+        assertEquals("0", diagnostic.getVMOption("MinHeapFreeRatio").getValue());
+        assertEquals("10", diagnostic.getVMOption("MaxHeapFreeRatio").getValue());
+        hibernation.restore();
+        assertEquals(min, diagnostic.getVMOption("MinHeapFreeRatio").getValue());
+        assertEquals(max, diagnostic.getVMOption("MaxHeapFreeRatio").getValue());
+    }
+
+    @Test
+    public void restoreTwice() {
+        final String max = diagnostic.getVMOption("MaxHeapFreeRatio").getValue();
+        final Hibernation hibernation = new Hibernation();
+        hibernation.shrink();
+        hibernation.restore();
+        hibernation.restore();
+        assertEquals(max, diagnostic.getVMOption("MaxHeapFreeRatio").getValue());
+    }
+
+}
@@ -0,0 +1,371 @@
+#!/bin/sh
+# Licensed to the Apache Software Foundation (ASF) under one or more
+# contributor license agreements.  See the NOTICE file distributed with
+# this work for additional information regarding copyright ownership.
+# The ASF licenses this file to You under the Apache License, Version 2.0
+# (the "License"); you may not use this file except in compliance with
+# the License.  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# End-to-end lifecycle benchmark of deimos, driving the sample BenchDaemon.
+#
+#   lifecycle.sh run [options]
+#       Benchmark one deimos executable and print the results as JSON.
+#   lifecycle.sh compare [options] <baseline> <candidate>
+#       Compare two results (JSON files or deimos executables, which are then
+#       benchmarked first) and exit with 1 if the candidate regressed.
+#
+# The crash restart is measured with -restartdelay 0, like the soak test:
+# otherwise the controller waits 60 s before restarting a JVM that ran for
+# less than 60 s, and the metric would only measure that delay.
+
+BENCH_DIR=`cd \`dirname $0\` && pwd`
+
+DEIMOS=
+SAMPLE_JAR=
+JDK=${JAVA_HOME}
+JARS=4
+CLASSES=100
+WORK=200
+ITERATIONS=5
+LINES=100000
+TIMEOUT=120
+THRESHOLD=10
+OUTPUT=
+EXTRA=
+
+usage()
+{
+        echo "Usage: $0 run [options]"
+        echo "       $0 compare [options] <baseline> <candidate>"
+        echo ""
+        echo "Where options include:"
+        echo "    -deimos <path>       deimos executable (run only)"
+        echo "    -home <directory>    JDK used to build and run the workload (defaults to JAVA_HOME)"
+        echo "    -sample <jar>        satellite-sample jar (defaults to ../build/libs)"
+        echo "    -jars <n>            synthetic jars on the manifest Class-Path (default ${JARS})"
+        echo "    -classes <n>         synthetic classes loaded per jar (default ${CLASSES})"
+        echo "    -work <ms>           CPU work done in initialize() (default ${WORK})"
+        echo "    -iterations <n>      samples taken for every warm metric (default ${ITERATIONS})"
+        echo "    -lines <n>           lines written to the logger (default ${LINES})"
+        echo "    -timeout <s>         maximum wait for a transition (default ${TIMEOUT})"
+        echo "    -threshold <pct>     regression tolerance for compare (default ${THRESHOLD})"
+        echo "    -out <file>          write the JSON results to file instead of stdout"
+        echo "    -- <options...>      extra options given to deimos"
+        exit 2
+}
+
+fail()
+{
+        echo "$0: $*" >&2
+        exit 1
+}
+
+now()
+{
+        date +%s%N
+}
+
+# Elapsed milliseconds between two now() values
+elapsed()
+{
+        awk -v s=$1 -v e=$2 'BEGIN { printf "%.3f\n", (e - s) / 1000000 }'
+}
+
+# Median of the numbers given on stdin
+median()
+{
+        sort -n | awk '{ v[NR] = $1 } END {
+                if (NR == 0) { print "null"; exit }
+                if (NR % 2) print v[(NR + 1) / 2]; else printf "%.3f\n", (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
+
+# Build the synthetic jars and the main jar of the workload
+generate()
+{
+        [ -x "${JDK}/bin/javac" ] || fail "no javac in ${JDK}, use -home"
+        if [ -z "${SAMPLE_JAR}" ]; then
+                SAMPLE_JAR=`ls ${BENCH_DIR}/../build/libs/satellite-sample*.jar 2>/dev/null | head -1`
+        fi
+        [ -f "${SAMPLE_JAR}" ] || fail "cannot find satellite-sample jar, use -sample"
+
+        mkdir -p ${WORKLOAD}/src ${WORKLOAD}/classes ${WORKLOAD}/lib
+        cp ${SAMPLE_JAR} ${WORKLOAD}/lib/satellite-sample.jar
+        CLASSPATH_ENTRIES="lib/satellite-sample.jar"
+        j=0
+        while [ $j -lt ${JARS} ]; do
+                rm -rf ${WORKLOAD}/src/* ${WORKLOAD}/classes/*
+                mkdir -p ${WORKLOAD}/src/bench/synth/j$j
+                c=0
+                while [ $c -lt ${CLASSES} ]; do
+                        cat > ${WORKLOAD}/src/bench/synth/j$j/C$c.java <<EOF
+package bench.synth.j$j;
+
+public final class C$c {
+    static final int[] VALUES = new int[64];
+    static {
+        for (int i = 0; i < VALUES.length; i++) {
+            VALUES[i] = (i * $c) ^ $j;
+        }
+    }
+    public static int touch() {
+        int sum = 0;
+        for (int value : VALUES) {
+            sum += value;
+        }
+        return sum;
+    }
+}
+EOF
+                        c=`expr $c + 1`
+                done
+                ${JDK}/bin/javac -nowarn -d ${WORKLOAD}/classes `find ${WORKLOAD}/src -name '*.java'` \
+                        || fail "cannot compile synthetic jar $j"
+                ${JDK}/bin/jar cf ${WORKLOAD}/lib/synth-$j.jar -C ${WORKLOAD}/classes . \
+                        || fail "cannot package synthetic jar $j"
+                CLASSPATH_ENTRIES="${CLASSPATH_ENTRIES} lib/synth-$j.jar"
+                j=`expr $j + 1`
+        done
+
+        cat > ${WORKLOAD}/manifest.txt <<EOF
+Background-Process-Class: io.zatarox.satellite.sample.BenchDaemon
+Class-Path: ${CLASSPATH_ENTRIES}
+EOF
+        # The manifest format forbids lines longer than 72 bytes
+        awk '{ while (length($0) > 70) { print substr($0, 1, 70); $0 = " " substr($0, 71) } print }' \
+                ${WORKLOAD}/manifest.txt > ${WORKLOAD}/manifest.mf
+        rm -rf ${WORKLOAD}/src ${WORKLOAD}/classes
+        mkdir -p ${WORKLOAD}/empty
+        ${JDK}/bin/jar cfm ${WORKLOAD}/bench.jar ${WORKLOAD}/manifest.mf -C ${WORKLOAD}/empty . \
+                || fail "cannot package main jar"
+}
+
+# Wait until the state file contains the expected value
+wait_state()
+{
+        limit=`expr \`date +%s\` + ${TIMEOUT}`
+        while [ "`cat ${STATE}/state 2>/dev/null`" != "$1" ]; do
+                [ `date +%s` -gt ${limit} ] && fail "timeout waiting for state $1"
+                sleep 0.01
+        done
+}
+
+# Wait until a (new) JVM process is ready according to deimos
+wait_ready()
+{
+        limit=`expr \`date +%s\` + ${TIMEOUT}`
+        while :; do
+                pid=`cat ${PIDFILE} 2>/dev/null`
+                if [ -n "${pid}" ] && [ "${pid}" != "$1" ] && [ -f /tmp/${pid}.deimos_up ]; then
+                        break
+                fi
+                [ `date +%s` -gt ${limit} ] && fail "timeout waiting for deimos readiness"
+                sleep 0.01
+        done
+        wait_state running
+}
+
+# Start deimos with stdout to $1, $2 logger lines, and the options $3
+deimos_start()
+{
+        rm -f ${STATE}/state
+        ${DEIMOS} -home ${JDK} -pidfile ${PIDFILE} -cwd ${WORKLOAD} \
+                -outfile $1 -errfile ${WORKLOAD}/deimos.err $3 ${EXTRA} \
+                ${WORKLOAD}/bench.jar -state ${STATE} -jars ${JARS} -classes ${CLASSES} \
+                -work ${WORK} -lines $2 || fail "cannot start ${DEIMOS}"
+}
+
+deimos_command()
+{
+        ${DEIMOS} -pidfile ${PIDFILE} $1 || fail "deimos $1 failed"
+}
+
+# Drop the page cache to make the next start a cold one (root only)
+drop_caches()
+{
+        sync
+        echo 3 2>/dev/null > /proc/sys/vm/drop_caches
+}
+
+run()
+{
+        [ -n "${DEIMOS}" ] || usage
+        case ${DEIMOS} in
+                /*) ;;
+                *) DEIMOS=`pwd`/${DEIMOS} ;;
+        esac
+        [ -x "${DEIMOS}" ] || fail "${DEIMOS} is not executable"
+
+        WORKLOAD=`mktemp -d /tmp/deimos-bench.XXXXXX`
+        STATE=${WORKLOAD}/state
+        PIDFILE=${WORKLOAD}/bench.pid
+        mkdir -p ${STATE}
+        trap "${DEIMOS} -pidfile ${PIDFILE} shutdown >/dev/null 2>&1; rm -rf ${WORKLOAD}" EXIT
+        generate
+
+        # Cold start: only meaningful when we are allowed to drop the caches
+        COLD=null
+        if drop_caches; then
+                t0=`now`
+                deimos_start /dev/null 0
+                wait_ready
+                COLD=`elapsed $t0 \`now\``
+                deimos_command shutdown
+        else
+                echo "$0: cannot drop the page cache, cold start not measured" >&2
+        fi
+
+        : > ${WORKLOAD}/warm
+        : > ${WORKLOAD}/pause
+        : > ${WORKLOAD}/shutdown
+        i=0
+        while [ $i -lt ${ITERATIONS} ]; do
+                t0=`now`
+                deimos_start /dev/null 0
+                wait_ready
+                elapsed $t0 `now` >> ${WORKLOAD}/warm
+
+                t0=`now`
+                deimos_command pause
+                wait_state paused
+                deimos_command resume
+                wait_state running
+                elapsed $t0 `now` >> ${WORKLOAD}/pause
+
+                t0=`now`
+                deimos_command shutdown
+                elapsed $t0 `now` >> ${WORKLOAD}/shutdown
+                i=`expr $i + 1`
+        done
+
+        # Restart after a crash of the JVM process, detected by the controller,
+        # without the delay that keeps a crashing JVM from looping
+        deimos_start /dev/null 0 "-restartdelay 0"
+        wait_ready
+        pid=`cat ${PIDFILE}`
+        t0=`now`
+        kill -9 ${pid}
+        wait_ready ${pid}
+        CRASH=`elapsed $t0 \`now\``
+        deimos_command shutdown
+
+        # Logger throughput: stdout goes through the syslog logger process
+        LOGGER=null
+        if [ ${LINES} -gt 0 ]; then
+                rm -f ${STATE}/logger
+                deimos_start SYSLOG ${LINES}
+                wait_ready
+                LOGGER=`awk '{ printf "%.1f", $1 * 1000000000 / $3 }' ${STATE}/logger`
+                deimos_command shutdown
+        fi
+
+        {
+                echo "{"
+                echo "  \"deimos\": \"${DEIMOS}\","
+                echo "  \"date\": \"`date -u +%Y-%m-%dT%H:%M:%SZ`\","
+                echo "  \"jars\": ${JARS},"
+                echo "  \"classes\": ${CLASSES},"
+                echo "  \"work_ms\": ${WORK},"
+                echo "  \"iterations\": ${ITERATIONS},"
+                echo "  \"cold_start_ms\": ${COLD},"
+                echo "  \"warm_start_ms\": `median < ${WORKLOAD}/warm`,"
+                echo "  \"pause_resume_ms\": `median < ${WORKLOAD}/pause`,"
+                echo "  \"shutdown_ms\": `median < ${WORKLOAD}/shutdown`,"
+                echo "  \"crash_restart_ms\": ${CRASH},"
+                echo "  \"logger_lines_per_s\": ${LOGGER}"
+                echo "}"
+        } > ${WORKLOAD}/result.json
+        if [ -n "${OUTPUT}" ]; then
+                cp ${WORKLOAD}/result.json ${OUTPUT}
+        else
+                cat ${WORKLOAD}/result.json
+        fi
+}
+
+# Benchmark an executable or return the JSON file as is
+result_of()
+{
+        if [ -x "$1" ] && [ ! -d "$1" ]; then
+                out=`mktemp /tmp/deimos-bench.XXXXXX.json`
+                ( DEIMOS=$1; OUTPUT=${out}; run ) || fail "benchmark of $1 failed"
+                echo ${out}
+        else
+                [ -f "$1" ] || fail "cannot read $1"
+                echo $1
+        fi
+}
+
+compare()
+{
+        [ $# -eq 2 ] || usage
+        base=`result_of $1` || exit 1
+        cand=`result_of $2` || exit 1
+        awk -v threshold=${THRESHOLD} '
+                function load(file, values,    line, key, value) {
+                        while ((getline line < file) > 0) {
+                                if (line !~ /^ *"[a-z_]+_(ms|per_s)": /)
+                                        continue
+                                key = line; sub(/^ *"/, "", key); sub(/".*/, "", key)
+                                value = line; sub(/^[^:]*: */, "", value); sub(/,$/, "", value)
+                                values[key] = value
+                        }
+                        close(file)
+                }
+                BEGIN {
+                        load(ARGV[1], base); load(ARGV[2], cand)
+                        printf "%-22s %14s %14s %9s\n", "metric", "baseline", "candidate", "delta"
+                        regressed = 0
+                        for (key in base) {
+                                if (base[key] == "null" || cand[key] == "null" || cand[key] == "" || base[key] == 0)
+                                        continue
+                                delta = (cand[key] - base[key]) * 100 / base[key]
+                                # Throughputs regress when they drop, latencies when they grow
+                                worse = key ~ /_per_s$/ ? -delta : delta
+                                flag = worse > threshold ? "  REGRESSION" : ""
+                                if (flag != "")
+                                        regressed = 1
+                                printf "%-22s %14s %14s %+8.1f%%%s\n", key, base[key], cand[key], delta, flag
+                        }
+                        exit regressed
+                }' ${base} ${cand}
+}
+
+COMMAND=$1
+[ -n "${COMMAND}" ] && shift
+while [ $# -gt 0 ]; do
+        case $1 in
+                -deimos) DEIMOS=$2; shift ;;
+                -home) JDK=$2; shift ;;
+                -sample) SAMPLE_JAR=$2; shift ;;
+                -jars) JARS=$2; shift ;;
+                -classes) CLASSES=$2; shift ;;
+                -work) WORK=$2; shift ;;
+                -iterations) ITERATIONS=$2; shift ;;
+                -lines) LINES=$2; shift ;;
+                -timeout) TIMEOUT=$2; shift ;;
+                -threshold) THRESHOLD=$2; shift ;;
+                -out) OUTPUT=$2; shift ;;
+                --) shift; EXTRA="$*"; break ;;
+                -*) usage ;;
+                *) break ;;
+        esac
+        shift
+done
+
+case ${COMMAND} in
+        run)
+                run
+        ;;
+        compare)
+                compare "$@"
+        ;;
+        *)
+                usage
+esac
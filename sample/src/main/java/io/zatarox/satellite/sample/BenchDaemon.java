@@ -0,0 +1,145 @@
+/*
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+package io.zatarox.satellite.sample;
+
+import io.zatarox.satellite.*;
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+
+/**
+ * Synthetic background process driven by the lifecycle benchmark
+ * (see bench/lifecycle.sh). Every transition is published in a state
+ * directory so that the benchmark can observe it from outside the JVM.
+ *
+ * Recognized arguments:
+ * <ul>
+ * <li><code>-state &lt;dir&gt;</code> directory receiving state files
+ * (mandatory)</li>
+ * <li><code>-jars &lt;n&gt;</code> number of synthetic jars to load classes
+ * from</li>
+ * <li><code>-classes &lt;n&gt;</code> number of synthetic classes per jar</li>
+ * <li><code>-work &lt;ms&gt;</code> CPU bound work done in initialize()</li>
+ * <li><code>-lines &lt;n&gt;</code> number of lines written to stdout on the
+ * first resume() to measure the logger throughput</li>
+ * </ul>
+ */
+public final class BenchDaemon implements BackgroundProcess {
+
+    private static final int LINE_SIZE = 100;
+
+    private File state;
+    private int jars;
+    private int classes;
+    private long work;
+    private int lines;
+    private volatile long sink;
+
+    @Override
+    public void initialize(BackgroundContext dc) throws BackgroundException, Exception {
+        final String[] args = dc.getArguments();
+        for (int i = 0; i + 1 < args.length; i += 2) {
+            if ("-state".equals(args[i])) {
+                state = new File(args[i + 1]);
+            } else if ("-jars".equals(args[i])) {
+                jars = Integer.parseInt(args[i + 1]);
+            } else if ("-classes".equals(args[i])) {
+                classes = Integer.parseInt(args[i + 1]);
+            } else if ("-work".equals(args[i])) {
+                work = Long.parseLong(args[i + 1]);
+            } else if ("-lines".equals(args[i])) {
+                lines = Integer.parseInt(args[i + 1]);
+            } else {
+                throw new BackgroundException("Invalid argument " + args[i]);
+            }
+        }
+        if (state == null) {
+            throw new BackgroundException("No state directory specified");
+        }
+
+        /* Load (and initialize) every synthetic class */
+        final ClassLoader loader = getClass().getClassLoader();
+        for (int j = 0; j < jars; j++) {
+            for (int c = 0; c < classes; c++) {
+                Class.forName("bench.synth.j" + j + ".C" + c, true, loader);
+            }
+        }
+
+        /* Burn some CPU as a static initialization would do */
+        final long end = System.nanoTime() + work * 1000000L;
+        long value = 0;
+        while (System.nanoTime() < end) {
+            for (int i = 0; i < 1000; i++) {
+                value = value * 31 + i;
+            }
+        }
+        sink = value;
+        publish("state", "initialized");
+    }
+
+    @Override
+    public void resume() throws Exception {
+        if (lines > 0) {
+            final StringBuilder line = new StringBuilder(LINE_SIZE);
+            while (line.length() < LINE_SIZE - 1) {
+                line.append('x');
+            }
+            final long start = System.nanoTime();
+            for (int i = 0; i < lines; i++) {
+                System.out.println(line);
+            }
+            System.out.flush();
+            final long elapsed = System.nanoTime() - start;
+            publish("logger", lines + " " + ((long) lines * LINE_SIZE) + " " + elapsed);
+            lines = 0;
+        }
+        publish("state", "running");
+    }
+
+    @Override
+    public void pause() throws Exception {
+        publish("state", "paused");
+    }
+
+    @Override
+    public void shutdown() {
+        try {
+            publish("state", "shutdown");
+        } catch (IOException ex) {
+        }
+    }
+
+    /* Atomically replace a state file content */
+    private void publish(String name, String value) throws IOException {
+        final File temp = new File(state, name + ".tmp");
+        final FileOutputStream out = new FileOutputStream(temp);
+        try {
+            out.write((value + "\n").getBytes("UTF-8"));
+        } finally {
+            out.close();
+        }
+        if (!temp.renameTo(new File(state, name))) {
+            throw new IOException("Cannot publish " + name);
+        }
+    }
+
+}